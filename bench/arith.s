@@ -0,0 +1,59 @@
+/*
+ * arith.s: packed BCD counting with da, and mul/div.
+ * Each pass adds 1 to an 8 digit BCD counter at 0x30-0x33 (least
+ * significant byte first), then folds the counter through mul AB and
+ * div AB into a running checksum.
+ *
+ * Result: BCD counter at 0x30-0x33, checksum in XDATA 0x0000.
+ */
+        .text
+        .globl _start
+_start:
+        mov sp,#0x2F
+        mov 0x30,#0
+        mov 0x31,#0
+        mov 0x32,#0
+        mov 0x33,#0
+        mov r4,#0               /* checksum */
+        mov r7,#100             /* 100 x 250 passes */
+outer:
+        mov r6,#250
+inner:
+        mov A,0x30
+        add A,#1
+        da A
+        mov 0x30,A
+        mov A,0x31
+        addc A,#0
+        da A
+        mov 0x31,A
+        mov A,0x32
+        addc A,#0
+        da A
+        mov 0x32,A
+        mov A,0x33
+        addc A,#0
+        da A
+        mov 0x33,A
+        mov A,0x30
+        mov b,#13
+        mul AB
+        xrl A,b
+        mov b,#7
+        div AB
+        add A,b
+        add A,r4
+        mov b,A
+        mov A,0x31
+        orl A,#1
+        xch A,b
+        div AB
+        xrl A,b
+        mov r4,A
+        djnz r6,inner
+        djnz r7,outer
+        mov DPTR,#0
+        mov A,r4
+        movx @DPTR,A
+halt:
+        sjmp halt
@@ -0,0 +1,77 @@
+/*
+ * bits.s: bit manipulation.
+ * Shifts bytes out on P1.0 with a clock on P1.1 (bit-banged SPI),
+ * counts set bits of the bit-addressable area through B with jb/jnb,
+ * and toggles flags with cpl, anl/orl C and mov bit,C.
+ *
+ * Result: population count of 0x20-0x2F, summed over all passes
+ * (mod 256), in XDATA 0x0000.
+ */
+        .text
+        .globl _start
+_start:
+        mov sp,#0x2F
+        mov r0,#0x20
+        mov A,#0x5A
+fill:
+        mov @R0,A
+        rl A
+        inc A
+        inc r0
+        cjne r0,#0x30,fill
+        mov r4,#0               /* population count */
+        mov r7,#200             /* passes */
+pass:
+        mov r0,#0x20
+send:
+        mov A,@R0
+        mov r5,#8
+shift:
+        rlc A
+        mov _P1.0,C
+        setb _P1.1
+        clr _P1.1
+        djnz r5,shift
+        inc r0
+        cjne r0,#0x30,send
+        mov r0,#0x20
+count:
+        mov b,@R0
+        jnb _B.0,c1
+        inc r4
+c1:     jnb _B.1,c2
+        inc r4
+c2:     jnb _B.2,c3
+        inc r4
+c3:     jnb _B.3,c4
+        inc r4
+c4:     jb _B.4,s4
+        sjmp c5
+s4:     inc r4
+c5:     jb _B.5,s5
+        sjmp c6
+s5:     inc r4
+c6:     jb _B.6,s6
+        sjmp c7
+s6:     inc r4
+c7:     jb _B.7,s7
+        sjmp c8
+s7:     inc r4
+c8:
+        inc r0
+        cjne r0,#0x30,count
+        cpl 0x00                /* 0x20.0 */
+        mov C,0x09
+        anl C,0x12
+        orl C,/0x1B
+        mov 0x24,C
+        jbc 0x2D,toggled
+        setb 0x2D
+toggled:
+        cpl 0x7F
+        djnz r7,pass
+        mov DPTR,#0
+        mov A,r4
+        movx @DPTR,A
+halt:
+        sjmp halt
@@ -0,0 +1,75 @@
+/*
+ * copy.s: block copies.
+ * Copies 1K of code memory to XDATA 0x1000 with movc, then copies it
+ * XDATA to XDATA (0x1000 to 0x2000) with movx through two pointers
+ * swapped in and out of DPTR.
+ *
+ * Result: byte sum of XDATA 0x2000-0x23FF in XDATA 0x0000.
+ */
+        .text
+        .globl _start
+_start:
+        mov sp,#0x2F
+        mov r7,#20              /* passes */
+pass:
+        mov DPTR,#0
+        mov r2,#0x10            /* destination high */
+        mov r3,#0               /* destination low */
+        mov r5,#4               /* 4 x 256 bytes */
+code1:
+        mov r6,#0
+code2:
+        clr A
+        movc A,@A+DPTR
+        inc DPTR
+        push dpl
+        push dph
+        mov dph,r2
+        mov dpl,r3
+        movx @DPTR,A
+        inc DPTR
+        mov r2,dph
+        mov r3,dpl
+        pop dph
+        pop dpl
+        djnz r6,code2
+        djnz r5,code1
+        mov DPTR,#0x1000        /* source */
+        mov r2,#0x20            /* destination high */
+        mov r3,#0
+        mov r5,#4
+data1:
+        mov r6,#0
+data2:
+        movx A,@DPTR
+        inc DPTR
+        mov r0,dpl
+        mov r1,dph
+        mov dph,r2
+        mov dpl,r3
+        movx @DPTR,A
+        inc DPTR
+        mov r2,dph
+        mov r3,dpl
+        mov dpl,r0
+        mov dph,r1
+        djnz r6,data2
+        djnz r5,data1
+        djnz r7,pass
+        mov DPTR,#0x2000
+        mov r4,#0
+        mov r5,#4
+sum1:
+        mov r6,#0
+sum2:
+        movx A,@DPTR
+        add A,r4
+        mov r4,A
+        inc DPTR
+        djnz r6,sum2
+        djnz r5,sum1
+        mov DPTR,#0
+        mov A,r4
+        movx @DPTR,A
+halt:
+        sjmp halt
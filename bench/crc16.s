@@ -0,0 +1,47 @@
+/*
+ * crc16.s: CRC-16/CCITT (polynomial 0x1021, initial value 0xFFFF),
+ * computed bit by bit over the first 256 bytes of code memory.
+ * Arithmetic and shift heavy: rlc, xrl, djnz.
+ *
+ * Result: CRC in XDATA 0x0000 (high) and 0x0001 (low).
+ */
+        .text
+        .globl _start
+_start:
+        mov sp,#0x2F
+        mov r7,#40              /* passes */
+pass:
+        mov r2,#0xFF            /* crc high */
+        mov r3,#0xFF            /* crc low */
+        mov DPTR,#0
+        mov r6,#0               /* 256 bytes */
+byte:
+        clr A
+        movc A,@A+DPTR
+        inc DPTR
+        xrl A,r2
+        mov r2,A
+        mov r5,#8
+bit:
+        clr C
+        mov A,r3
+        rlc A
+        mov r3,A
+        mov A,r2
+        rlc A
+        mov r2,A
+        jnc nox
+        xrl ar2,#0x10
+        xrl ar3,#0x21
+nox:
+        djnz r5,bit
+        djnz r6,byte
+        djnz r7,pass
+        mov DPTR,#0
+        mov A,r2
+        movx @DPTR,A
+        inc DPTR
+        mov A,r3
+        movx @DPTR,A
+halt:
+        sjmp halt
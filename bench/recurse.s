@@ -0,0 +1,47 @@
+/*
+ * recurse.s: call/return heavy recursion.
+ * Naive recursive Fibonacci, counting the leaves of the call tree;
+ * the outer loop uses lcall, the recursion acall, with push/pop of the
+ * argument across calls.
+ *
+ * Result: leaves of fib(16) summed over all passes, mod 65536,
+ * in XDATA 0x0000 (high) and 0x0001 (low).
+ */
+        .text
+        .globl _start
+_start:
+        mov sp,#0x2F
+        mov r2,#0               /* leaf count high */
+        mov r3,#0               /* leaf count low */
+        mov r7,#20              /* passes */
+pass:
+        mov A,#16
+        lcall fib
+        djnz r7,pass
+        mov DPTR,#0
+        mov A,r2
+        movx @DPTR,A
+        inc DPTR
+        mov A,r3
+        movx @DPTR,A
+halt:
+        sjmp halt
+
+/* fib: A = n. Counts fib(n + 1) leaves in r2:r3. A is preserved. */
+fib:
+        cjne A,#2,fib1
+fib1:
+        jc leaf
+        push _ACC
+        dec A
+        acall fib
+        dec A
+        acall fib
+        pop _ACC
+        ret
+leaf:
+        inc r3
+        cjne r3,#0,done
+        inc r2
+done:
+        ret
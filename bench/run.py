@@ -0,0 +1,160 @@
+#!/usr/bin/env python3
+#
+# Benchmark harness for the ArchC i8051 model.
+#
+# Runs each benchmark image several times through the simulator, reads
+# the end of run statistics the model writes to I8051_STATS, and
+# reports simulated instructions/s and machine cycles/s (mean, standard
+# deviation, min, max). Results are stored as JSON for trend tracking.
+#
+# Copyright (C) 2002-2006 --- The ArchC Team
+#
+
+import argparse
+import datetime
+import glob
+import json
+import os
+import platform
+import shutil
+import statistics
+import subprocess
+import sys
+import tempfile
+
+BENCH = os.path.dirname(os.path.abspath(__file__))
+ROOT = os.path.dirname(BENCH)
+
+
+def summary(values):
+    return {
+        "mean": statistics.mean(values),
+        "stdev": statistics.stdev(values) if len(values) > 1 else 0.0,
+        "min": min(values),
+        "max": max(values),
+    }
+
+
+def build_dhrystone(src, workdir, runs):
+    """Compile Dhrystone 2.1 (dhry_1.c, dhry_2.c, dhry.h in src) with SDCC."""
+    if shutil.which("sdcc") is None:
+        sys.exit("run.py: --dhrystone needs sdcc in PATH")
+    flags = ["-mmcs51", "--model-large", "-DTIME", "-DNOSTRUCTASSIGN",
+             "-DDHRY_RUNS=%d" % runs, "-I" + src]
+    units = [(os.path.join(BENCH, "dhrystone", "shim.c"), []),
+             (os.path.join(src, "dhry_1.c"), ["-Dmain=dhry_main"]),
+             (os.path.join(src, "dhry_2.c"), [])]
+    rels = []
+    for c, extra in units:
+        rel = os.path.join(workdir, os.path.basename(c)[:-2] + ".rel")
+        subprocess.run(["sdcc"] + flags + extra + ["-c", c, "-o", rel],
+                       check=True)
+        rels.append(rel)
+    ihx = os.path.join(workdir, "dhrystone.ihx")
+    subprocess.run(["sdcc", "-mmcs51", "--model-large", "--xram-size", "0x8000"]
+                   + rels + ["-o", ihx], check=True)
+    return ihx
+
+
+def run_once(cmd, image, workdir):
+    stats = os.path.join(workdir, "stats.json")
+    env = dict(os.environ, I8051_IMAGE=image, I8051_STATS=stats,
+               I8051_HALT="1")
+    if os.path.exists(stats):
+        os.unlink(stats)
+    args = [a.format(image=image) for a in cmd]
+    subprocess.run(args, env=env, stdout=subprocess.DEVNULL, check=True)
+    with open(stats) as f:
+        return json.load(f)
+
+
+def main():
+    ap = argparse.ArgumentParser(
+        description="Run the i8051 benchmarks and record their speed.")
+    ap.add_argument("names", nargs="*",
+                    help="benchmarks to run (default: all)")
+    ap.add_argument("--sim", default=os.path.join(ROOT, "i8051.x"),
+                    help="simulator executable (default: ../i8051.x)")
+    ap.add_argument("--cmd", default="{sim} --load={image}",
+                    help="command line template; {sim} and {image} are "
+                         "replaced (default: %(default)s)")
+    ap.add_argument("--runs", type=int, default=5,
+                    help="runs per benchmark (default: 5)")
+    ap.add_argument("--dhrystone", metavar="DIR",
+                    help="build Dhrystone 2.1 from DIR with SDCC and run it")
+    ap.add_argument("--dhrystone-runs", type=int, default=2000)
+    ap.add_argument("--out", help="result file (default: "
+                                  "results/<timestamp>.json)")
+    opt = ap.parse_args()
+
+    if opt.runs < 1:
+        sys.exit("run.py: --runs must be at least 1")
+    cmd = opt.cmd.replace("{sim}", opt.sim).split()
+    workdir = tempfile.mkdtemp(prefix="i8051-bench-")
+    try:
+        images = {os.path.basename(p)[:-4]: p
+                  for p in sorted(glob.glob(os.path.join(BENCH, "*.hex")))}
+        if opt.dhrystone:
+            images["dhrystone"] = build_dhrystone(opt.dhrystone, workdir,
+                                                  opt.dhrystone_runs)
+        if opt.names:
+            missing = [n for n in opt.names if n not in images]
+            if missing:
+                sys.exit("run.py: unknown benchmark(s): " + " ".join(missing))
+            images = {n: images[n] for n in opt.names}
+
+        results = {}
+        print("%-10s %12s %12s %10s %8s %10s %8s" %
+              ("benchmark", "insts", "cycles", "MIPS", "+-", "Mcyc/s", "+-"))
+        for name, image in images.items():
+            samples = [run_once(cmd, image, workdir) for _ in range(opt.runs)]
+            insts = samples[0]["instructions"]
+            cycles = samples[0]["cycles"]
+            if any(s["instructions"] != insts or s["cycles"] != cycles
+                   for s in samples):
+                print("run.py: %s: counts differ between runs" % name,
+                      file=sys.stderr)
+            secs = [max(s["host_seconds"], 1e-9) for s in samples]
+            ips = summary([s["instructions"] / t for s, t in zip(samples, secs)])
+            cps = summary([s["cycles"] / t for s, t in zip(samples, secs)])
+            results[name] = {
+                "instructions": insts,
+                "cycles": cycles,
+                "final_pc": samples[0]["pc"],
+                "host_seconds": secs,
+                "instructions_per_second": ips,
+                "cycles_per_second": cps,
+            }
+            print("%-10s %12d %12d %10.3f %8.3f %10.3f %8.3f" %
+                  (name, insts, cycles, ips["mean"] / 1e6, ips["stdev"] / 1e6,
+                   cps["mean"] / 1e6, cps["stdev"] / 1e6))
+    finally:
+        shutil.rmtree(workdir, ignore_errors=True)
+
+    try:
+        rev = subprocess.run(["git", "-C", ROOT, "describe", "--always",
+                              "--dirty"], capture_output=True, text=True,
+                             check=True).stdout.strip()
+    except (OSError, subprocess.CalledProcessError):
+        rev = None
+    now = datetime.datetime.now(datetime.timezone.utc)
+    report = {
+        "timestamp": now.strftime("%Y-%m-%dT%H:%M:%SZ"),
+        "revision": rev,
+        "host": platform.node(),
+        "machine": platform.machine(),
+        "simulator": opt.sim,
+        "runs": opt.runs,
+        "benchmarks": results,
+    }
+    out = opt.out or os.path.join(BENCH, "results",
+                                  now.strftime("%Y%m%dT%H%M%SZ") + ".json")
+    os.makedirs(os.path.dirname(os.path.abspath(out)), exist_ok=True)
+    with open(out, "w") as f:
+        json.dump(report, f, indent=1, sort_keys=True)
+        f.write("\n")
+    print("results written to " + out)
+
+
+if __name__ == "__main__":
+    main()
@@ -23,36 +23,659 @@
 #include "i8051_isa_init.cpp"
 #include "i8051_bhv_macros.H"
 #include <systemc.h>
+#include "i8051_watch.H"
+#include "i8051_sched.H"
+#include "i8051_xdata.H"
+#include "i8051_mem.H"
+#include "i8051_derivative.H"
+#include "i8051_port.H"
+#include "i8051_timer2.H"
+#include "i8051_loader.H"
+#include "i8051_board.H"
+#include "i8051_stats.H"
+#include "i8051_core.H"
+#include "i8051_cosim.H"
+#include "i8051_stackcheck.H"
+#include "i8051_live.H"
+#include "i8051_unified.H"
 
 // Debug defines
 //#define _I8051_FORCE_END_ // Force the simulation to end.
 //#define _I8051_DUMP_MEMORY_ // Get a memory dump at the end of simulation.
+// The derivative (8052, dual DPTR, cycle table ...) is chosen with
+// I8051_DERIVATIVE, see i8051_derivative.H.
 // Defines
 #define ACC 224
 #define PSW 208
 #define B   240
-#define DPTRH 131
-#define DPTRL 130
+#define DPTRH (0x83 + dptr_index())
+#define DPTRL (0x82 + dptr_index())
+#define DPS   0x86
 #define SP 129
+#define P2    0xA0
+#define TCON  0x88
+#define SCON  0x98
+#define IE    0xA8
+#define IP    0xB8
+#define T2CON 0xC8
+// Direct address hooks (dhook[])
+#define HOOK_WATCH 0x01         // log writes
+#define HOOK_PORT  0x02         // I/O port latch and pins
+#define HOOK_IRQ   0x04         // interrupt control registers
+#define HOOK_PSW   0x08         // PSW.P is derived from ACC when read
+#define HOOK_TIMER 0x10         // Timer 2 count and reload, computed on read
+#define HOOK_T2CON 0x20         // Timer 2 control
+#define HOOK_READ  (HOOK_PORT | HOOK_PSW | HOOK_TIMER)
 
 using namespace i8051_parms;
 
-void memdump(const char* fn, ac_memport<ac_word, ac_Hword>& sto)
+void memdump(const char* fn, const unsigned char* data, unsigned size)
 {
  fstream dfile;
  unsigned i;
 
  dfile.open(fn, ios::out);
- for (i = 0; i < sto.get_size(); i += (sizeof(ac_word)))
-  dfile << hex << i << "  " << sto.read(i) << endl;
+ for (i = 0; i < size; i++)
+  dfile << hex << i << "  " << (unsigned) data[i] << '\n';
  dfile.close();
  return;
 }
 
+//! Direct address (lower IRAM and SFR) accessors. Bytes flagged in
+//! dhook[] take the slow path; read-modify-write instructions read the
+//! SFR byte itself, so they see the port latches instead of the pins.
+inline unsigned i8051_isa::direct_read(unsigned addr)
+{
+ stats->reads[addr >> 7]++;
+ if (dhook[addr] & HOOK_READ)
+  return direct_read_slow(addr);
+ return IRAM.read(addr);
+}
+
+inline void i8051_isa::direct_write(unsigned addr, unsigned data)
+{
+ stats->writes[addr >> 7]++;
+ if (dhook[addr])
+  direct_write_slow(addr, data);
+ else
+  IRAM.write(addr, data);
+ return;
+}
+
+//! Read of the byte a read-modify-write instruction changes: the port
+//! latch rather than the pins, the current Timer 2 count.
+inline unsigned i8051_isa::latch_read(unsigned addr)
+{
+ stats->reads[addr >> 7]++;
+ if (dhook[addr] & HOOK_TIMER)
+  return timer2->read(addr, cycles);
+ return IRAM.read(addr);
+}
+
+//! PSW with the parity of ACC. Behaviors never update PSW.P: it only
+//! matters when PSW is read, so it is computed there instead.
+inline unsigned i8051_isa::psw_read()
+{
+ return (IRAM.read(PSW) & 0xFE) | i8051_parity(IRAM.read(ACC));
+}
+
+unsigned i8051_isa::direct_read_slow(unsigned addr)
+{
+ if (dhook[addr] & HOOK_PSW)
+  return psw_read();
+ if (dhook[addr] & HOOK_PORT)
+  return ports->pins(I8051_PORT_INDEX(addr));
+ if (dhook[addr] & HOOK_TIMER)
+  return timer2->read(addr, cycles);
+ return IRAM.read(addr);
+}
+
+void i8051_isa::direct_write_slow(unsigned addr, unsigned data)
+{
+ if (dhook[addr] & HOOK_WATCH)
+  i8051_watch_log(watch, ac_instr_counter, inst_pc, 'D', 'W', addr, data);
+ if (addr == PSW && ((IRAM.read(PSW) ^ data) & 0x18))
+  stats->bank_switches++;
+ direct_store(addr, data);
+ return;
+}
+
+//! Store into the direct space with the side effects of the SFR, but
+//! without the watch and the statistics.
+void i8051_isa::direct_store(unsigned addr, unsigned data)
+{
+ unsigned p3;
+
+ IRAM.write(addr, data);
+ if (dhook[addr] & HOOK_PORT)
+  ports->write_latch(I8051_PORT_INDEX(addr), data, cycles);
+ if (dhook[addr] & (HOOK_TIMER | HOOK_T2CON))
+  timer2->write(addr, data, cycles);
+ // Software may set TF2 or EXF2 itself.
+ if (dhook[addr] & HOOK_T2CON)
+  irq_check = true;
+ if (dhook[addr] & HOOK_IRQ)
+ {
+  // Level triggered inputs keep their flags in step with the pins.
+  if (addr == TCON)
+  {
+   p3 = ports->pins(3);
+   ext_int(p3, p3);
+  }
+  // The instruction following a write to IE or IP is always executed.
+  if (addr == IE || addr == IP)
+   irq_hold = true;
+  irq_check = true;
+ }
+ return;
+}
+
+//! Indirect (@Ri and stack) accessors. ibank[] is indexed by the top
+//! address bit: with 256 bytes of IRAM the upper half is IDATA,
+//! otherwise it aliases the SFRs, and PSW there needs its parity.
+inline unsigned i8051_isa::ind_read(unsigned addr)
+{
+ stats->reads[I8051_ACC_IND]++;
+ addr &= 0xFF;
+ if (i8051_traits::iram_size <= 128 && addr == PSW)
+  return psw_read();
+ return ibank[addr >> 7]->read(addr);
+}
+
+inline void i8051_isa::ind_write(unsigned addr, unsigned data)
+{
+ stats->writes[I8051_ACC_IND]++;
+ addr &= 0xFF;
+ ibank[addr >> 7]->write(addr, data);
+ return;
+}
+
+//! Offset of the DPTR selected by DPS from DPL/DPH: 0, or 2 for
+//! DPL1/DPH1 on dual DPTR derivatives.
+inline unsigned i8051_isa::dptr_index()
+{
+ if (i8051_traits::dptrs > 1)
+  return (IRAM.read(DPS) & 1) << 1;
+ return 0;
+}
+
+//! Interrupt sources, in the order they are polled within a priority level.
+static const struct
+{
+ unsigned char flag_addr;       // SFR holding the request flag(s)
+ unsigned char flag_mask;
+ unsigned char clear_mask;      // flags cleared by hardware on vectoring
+ unsigned char it_bit;          // TCON type bit (edge when set), or 0
+ unsigned char vector;
+} irq_source[] = {
+ { TCON,  0x02, 0x02, 0x01, 0x03 },     // IE0, bit 0 of IE/IP
+ { TCON,  0x20, 0x20, 0x00, 0x0B },     // TF0
+ { TCON,  0x08, 0x08, 0x04, 0x13 },     // IE1
+ { TCON,  0x80, 0x80, 0x00, 0x1B },     // TF1
+ { SCON,  0x03, 0x00, 0x00, 0x23 },     // RI, TI
+ { T2CON, 0xC0, 0x00, 0x00, 0x2B }      // TF2, EXF2
+};
+
+//! Forwards P3 pin changes to the external interrupt inputs, P1 pin
+//! changes to Timer 2 (T2, T2EX), Timer 2 flags to T2CON, and live
+//! statistics updates and code written through XDATA to the model.
+class i8051_extint: public i8051_pin_listener, public i8051_timer2_listener,
+                    public i8051_live_listener, public i8051_code_listener
+{
+public:
+ i8051_isa* isa;
+
+ void pins_changed(int port, unsigned old_pins, unsigned new_pins,
+                   unsigned long long now)
+ {
+  if (port == 3 && ((old_pins ^ new_pins) & 0x0C))
+   isa->ext_int(old_pins, new_pins);
+  if (port == 1 && isa->timer2 != NULL && ((old_pins ^ new_pins) & 0x03))
+   isa->timer2->pins(old_pins, new_pins, now);
+ }
+
+ void timer2_flags(unsigned flags)
+ {
+  isa->timer2_flags(flags);
+ }
+
+ void live_update(unsigned long long now)
+ {
+  isa->live_update(now);
+ }
+
+ void code_written(unsigned addr, unsigned len)
+ {
+  isa->code_written(addr, len);
+ }
+};
+
+//! INT0 (P3.2) and INT1 (P3.3): a falling edge sets IEx when ITx is set,
+//! otherwise IEx follows the inverted pin level.
+void i8051_isa::ext_int(unsigned old_pins, unsigned new_pins)
+{
+ sc_uint<8> tcon = IRAM.read(TCON);
+
+ if (tcon[0])
+ {
+  if ((old_pins & 0x04) && !(new_pins & 0x04))
+   tcon[1] = 1;
+ }
+ else
+  tcon[1] = !(new_pins & 0x04);
+ if (tcon[2])
+ {
+  if ((old_pins & 0x08) && !(new_pins & 0x08))
+   tcon[3] = 1;
+ }
+ else
+  tcon[3] = !(new_pins & 0x08);
+ IRAM.write(TCON, tcon);
+ irq_check = true;
+ return;
+}
+
+//! TF2 or EXF2 set by Timer 2.
+void i8051_isa::timer2_flags(unsigned flags)
+{
+ IRAM.write(T2CON, IRAM.read(T2CON) | flags);
+ irq_check = true;
+ return;
+}
+
+//! An enabled request is pending (EA set and its flag set).
+bool i8051_isa::irq_pending()
+{
+ unsigned ie = IRAM.read(IE);
+ int i;
+
+ if (!(ie & 0x80))
+  return false;
+ for (i = 0; i < (i8051_traits::timer2 ? 6 : 5); i++)
+  if ((ie & (1 << i)) &&
+      (IRAM.read(irq_source[i].flag_addr) & irq_source[i].flag_mask))
+   return true;
+ return false;
+}
+
+//! Vector to the highest priority pending interrupt, if it may preempt
+//! the ones in service. Returns true when the current instruction must
+//! be dropped.
+bool i8051_isa::irq_dispatch()
+{
+ sc_uint<8> ie = IRAM.read(IE);
+ sc_uint<8> ip = IRAM.read(IP);
+ sc_uint<9> sp;
+ unsigned level, best_level = 0;
+ int i, best = -1;
+
+ irq_check = false;
+ if (!ie[7])
+  return false;
+ // Timer 2, the last source, is only polled when there is one.
+ for (i = 0; i < (i8051_traits::timer2 ? 6 : 5); i++)
+ {
+  if (!ie[i] || !(IRAM.read(irq_source[i].flag_addr) & irq_source[i].flag_mask))
+   continue;
+  level = ip[i] ? 2 : 1;
+  if (level > best_level)
+  {
+   best_level = level;
+   best = i;
+  }
+ }
+ // irq_active holds one bit per priority level in service.
+ if (best < 0 || irq_active >= best_level)
+  return false;
+ if (irq_source[best].clear_mask &&
+     (!irq_source[best].it_bit || (IRAM.read(TCON) & irq_source[best].it_bit)))
+  IRAM.write(irq_source[best].flag_addr,
+             IRAM.read(irq_source[best].flag_addr) & ~irq_source[best].clear_mask);
+ irq_active |= best_level;
+ // Hardware LCALL to the vector, returning to the preempted instruction.
+ if (stackchk != NULL &&
+     i8051_stackcheck_call(stackchk, true, inst_pc, irq_source[best].vector,
+                           IRAM.read(SP), IRAM.read(PSW), cycles))
+  stop(1);
+ sp = IRAM.read(SP) + 1;
+ ind_write(sp.range(7, 0), inst_pc & 0xFF);
+ sp = sp.range(7, 0) + 1;
+ ind_write(sp.range(7, 0), (inst_pc >> 8) & 0xFF);
+ IRAM.write(SP, sp.range(7, 0));
+ cycles += i8051_traits::irq_cycles;
+ stats->interrupts++;
+ pc = irq_source[best].vector;
+ ac_pc = irq_source[best].vector;
+ if (cosim != NULL)
+  i8051_cosim_interrupt(cosim, irq_source[best].vector);
+ // Another, higher priority request may still be pending.
+ irq_check = true;
+ return true;
+}
+
+//! Publish counters, and the memories with ",mem", to the live segment.
+void i8051_isa::live_update(unsigned long long now)
+{
+ i8051_live_data* d = live->begin();
+ double t = i8051_host_time() - host_start;
+ unsigned i;
+
+ d->insts = insts;
+ d->cycles = now;
+ d->pc = ac_pc.read();
+ d->host_seconds = t;
+ if (live->mem)
+ {
+  for (i = 0; i < 256; i++)
+   d->iram[i] = IRAM.read(i);
+  d->iram[PSW] = psw_read();
+  if (timer2 != NULL)
+   for (i = I8051_RCAP2L; i <= I8051_TH2; i++)
+    d->iram[i] = timer2->read(i, now);
+  if (i8051_traits::iram_size > 128)
+   for (i = 0x80; i < 256; i++)
+    d->idata[i] = IDATA.read(i);
+  for (i = 0; i < 256; i++)
+  {
+   const unsigned char* p = i8051_xdata_host(xdata, i);
+
+   if (p != NULL)
+    memcpy(d->xdata + (i << 8), p, 0x100);
+   else
+    memset(d->xdata + (i << 8), 0, 0x100);
+  }
+ }
+ live->end(insts, t);
+ return;
+}
+
+//! Copy the architectural state into cosim->model for a comparison.
+void i8051_isa::cosim_fill()
+{
+ i8051_cosim_state* s = &cosim->model;
+ unsigned i;
+
+ s->pc = ac_pc.read();
+ for (i = 0; i < 256; i++)
+  s->iram[i] = IRAM.read(i);
+ s->iram[PSW] = psw_read();
+ if (timer2 != NULL)
+  for (i = I8051_RCAP2L; i <= I8051_TH2; i++)
+   s->iram[i] = timer2->read(i, cycles);
+ if (i8051_traits::iram_size > 128)
+  for (i = 0x80; i < 256; i++)
+   s->idata[i] = IDATA.read(i);
+ return;
+}
+
+//! External data memory accessors used by the movx behaviors.
+inline unsigned i8051_isa::xdata_read(unsigned addr)
+{
+ const unsigned char* p = xdata->page[addr >> 8];
+
+ stats->reads[I8051_ACC_XDATA]++;
+ if (p != NULL)
+  return p[addr & 0xFF];
+ return xdata_read_slow(addr);
+}
+
+inline void i8051_isa::xdata_write(unsigned addr, unsigned data)
+{
+ unsigned char* p = xdata->page[addr >> 8];
+
+ stats->writes[I8051_ACC_XDATA]++;
+ if (p != NULL)
+  p[addr & 0xFF] = data;
+ else
+  xdata_write_slow(addr, data);
+ return;
+}
+
+//! Trapped XDATA pages: devices and watched RAM.
+unsigned i8051_isa::xdata_read_slow(unsigned addr)
+{
+ i8051_xdev* dev = xdata->dev[addr >> 8];
+ unsigned data;
+
+ if (dev != NULL)
+ {
+  data = dev->read(addr, cycles) & 0xFF;
+  i8051_sched_update(sched);
+ }
+ else
+  data = xdata->ram[addr];
+ if (watch->xpage[addr >> 8] && i8051_watch_xmatch(watch, addr))
+  i8051_watch_log(watch, ac_instr_counter, inst_pc, 'X', 'R', addr, data);
+ return data;
+}
+
+void i8051_isa::xdata_write_slow(unsigned addr, unsigned data)
+{
+ i8051_xdev* dev = xdata->dev[addr >> 8];
+
+ if (watch->xpage[addr >> 8] && i8051_watch_xmatch(watch, addr))
+  i8051_watch_log(watch, ac_instr_counter, inst_pc, 'X', 'W', addr, data);
+ if (dev != NULL)
+ {
+  dev->write(addr, data & 0xFF, cycles);
+  i8051_sched_update(sched);
+ }
+ else
+  xdata->ram[addr] = data;
+ return;
+}
+
+//! Code bytes [addr, addr + len) changed in irom: copy them to IROM,
+//! where instructions are fetched from, and to the cosim reference.
+void i8051_isa::code_written(unsigned addr, unsigned len)
+{
+ unsigned i;
+
+ for (i = addr; i < addr + len; i++)
+  IROM.write(i, irom[i]);
+ if (cosim != NULL)
+  memcpy(cosim->ref.code + addr, irom + addr, len);
+ return;
+}
+
+//! Bulk memory accessors for harnesses (see i8051_mem.H).
+static bool mem_range(unsigned space, unsigned addr, unsigned len)
+{
+ unsigned lo = 0, hi = 0x10000;
+
+ if (space == I8051_MEM_DIRECT)
+  hi = 0x100;
+ else if (space == I8051_MEM_IDATA)
+ {
+  lo = 0x80;
+  hi = i8051_traits::iram_size > 128 ? 0x100 : 0x80;
+ }
+ else if (space != I8051_MEM_XDATA && space != I8051_MEM_IROM)
+  hi = 0;
+ if (addr < lo || addr >= hi || len > hi - addr)
+ {
+  fprintf(stderr, "i8051: bad memory range %x+%x in space %u\n", addr, len,
+          space);
+  return false;
+ }
+ return true;
+}
+
+bool i8051_isa::mem_read(unsigned space, unsigned addr, unsigned char* buf,
+                         unsigned len)
+{
+ unsigned i;
+
+ if (!mem_range(space, addr, len))
+  return false;
+ switch (space)
+ {
+  case I8051_MEM_DIRECT:
+   for (i = 0; i < len; i++)
+    if (dhook[addr + i] & HOOK_PSW)
+     buf[i] = psw_read();
+    else if (dhook[addr + i] & HOOK_TIMER)
+     buf[i] = timer2->read(addr + i, cycles);
+    else
+     buf[i] = IRAM.read(addr + i);
+   break;
+  case I8051_MEM_IDATA:
+   for (i = 0; i < len; i++)
+    buf[i] = IDATA.read(addr + i);
+   break;
+  case I8051_MEM_XDATA:
+   i8051_xdata_read_block(xdata, addr, buf, len, cycles);
+   i8051_sched_update(sched);
+   break;
+  case I8051_MEM_IROM:
+   memcpy(buf, irom + addr, len);
+   break;
+ }
+ return true;
+}
+
+bool i8051_isa::mem_write(unsigned space, unsigned addr,
+                          const unsigned char* buf, unsigned len)
+{
+ unsigned i;
+
+ if (!mem_range(space, addr, len))
+  return false;
+ switch (space)
+ {
+  case I8051_MEM_DIRECT:
+   for (i = 0; i < len; i++)
+    direct_store(addr + i, buf[i]);
+   break;
+  case I8051_MEM_IDATA:
+   for (i = 0; i < len; i++)
+    IDATA.write(addr + i, buf[i]);
+   break;
+  case I8051_MEM_XDATA:
+   i8051_xdata_write_block(xdata, addr, buf, len, cycles);
+   i8051_sched_update(sched);
+   break;
+  case I8051_MEM_IROM:
+   memcpy(irom + addr, buf, len);
+   code_written(addr, len);
+   break;
+ }
+ return true;
+}
+
+const unsigned char* i8051_isa::mem_span(unsigned space, unsigned addr,
+                                         unsigned len)
+{
+ if (!mem_range(space, addr, len))
+  return NULL;
+ if (space == I8051_MEM_XDATA)
+  return i8051_xdata_span(xdata, addr, len);
+ if (space == I8051_MEM_IROM)
+  return irom + addr;
+ return NULL;
+}
+
 // Initialize special registers for simulation
 void ac_behavior(begin)
 {
+ unsigned i;
+ const char* fn;
+ i8051_image img;
+
  IRAM.write(0x81, 0x7);
+ ibank[0] = &IRAM;
+ ibank[1] = i8051_traits::iram_size > 128 ? &IDATA : &IRAM;
+ for (i = 0x80; i <= 0xB0; i += 0x10)
+  IRAM.write(i, 0xFF);
+ cycles = 0;
+ insts = 0;
+ stats = new i8051_stats;
+ i8051_stats_init(stats);
+ watch = new i8051_watch;
+ i8051_watch_init(watch);
+ sched = new i8051_sched;
+ i8051_sched_init(sched);
+ xdata = new i8051_xdata;
+ i8051_xdata_init(xdata);
+ for (i = 0; i < 256; i++)
+ {
+  if (watch->xpage[i])
+   i8051_xdata_trap(xdata, i);
+  dhook[i] = watch->direct[i] ? HOOK_WATCH : 0;
+ }
+ ports = new i8051_ports;
+ i8051_ports_init(ports, sched);
+ for (i = 0x80; i <= 0xB0; i += 0x10)
+  dhook[i] |= HOOK_PORT;
+ extint = new i8051_extint;
+ extint->isa = this;
+ ports->listener = extint;
+ dhook[TCON] |= HOOK_IRQ;
+ // Software may set RI or TI itself.
+ dhook[SCON] |= HOOK_IRQ;
+ dhook[IE] |= HOOK_IRQ;
+ dhook[IP] |= HOOK_IRQ;
+ dhook[PSW] |= HOOK_PSW;
+ timer2 = NULL;
+ if (i8051_traits::timer2)
+ {
+  timer2 = new i8051_timer2(i8051_traits::clocks, sched);
+  timer2->listener = extint;
+  i8051_sched_add(sched, timer2);
+  for (i = I8051_RCAP2L; i <= I8051_TH2; i++)
+   dhook[i] |= HOOK_TIMER;
+  dhook[T2CON] |= HOOK_T2CON;
+ }
+ irq_active = 0;
+ irq_check = false;
+ irq_hold = false;
+ halt = getenv("I8051_HALT") != NULL;
+ i8051_board_setup(xdata, sched);
+ // Images given in I8051_IMAGE replace what --load placed in IROM.
+ if ((fn = getenv("I8051_IMAGE")) != NULL)
+ {
+  img.code = new unsigned char[0x10000]();
+  img.xdata = xdata->ram;
+  if (i8051_load(fn, &img))
+  {
+   for (i = img.code_lo; i < img.code_hi; i++)
+    IROM.write(i, img.code[i]);
+   ac_pc = img.entry;
+  }
+  else
+   stop(1);
+  delete[] img.code;
+ }
+ irom = new unsigned char[0x10000];
+ for (i = 0; i < 0x10000; i++)
+  irom[i] = IROM.read(i);
+ cosim = NULL;
+ if (!i8051_unified_open(xdata, sched, irom, extint))
+  stop(1);
+ if (getenv("I8051_COSIM") != NULL)
+ {
+  cosim = new i8051_cosim;
+  memset(cosim->model.idata, 0, sizeof(cosim->model.idata));
+  cosim->model.xram = xdata->ram;
+  cosim->model.port_input = ports->input;
+  cosim_fill();
+  i8051_cosim_init(cosim);
+  memcpy(cosim->ref.code, irom, 0x10000);
+  cosim->ref.is8052 = i8051_traits::iram_size > 128;
+  cosim->ref.dual_dptr = i8051_traits::dptrs > 1;
+  i8051_cosim_own(cosim, TCON);
+  if (timer2 != NULL)
+  {
+   i8051_cosim_own(cosim, T2CON);
+   for (i = I8051_RCAP2L; i <= I8051_TH2; i++)
+    i8051_cosim_own(cosim, i);
+  }
+  for (i = 0; i < 256; i++)
+   cosim->xdev[i] = (xdata->dev[i] != NULL);
+ }
+ stackchk = i8051_stackcheck_open();
+ host_start = i8051_host_time();
+ live = i8051_live_open(sched, extint);
 #ifdef _I8051_FORCE_END_
  pc_stability = 0;
  old_pc = 0;
@@ -66,32 +689,63 @@ void ac_behavior(end)
 {
 #ifdef _I8051_DUMP_MEMORY_
  char* filename;
+ unsigned char dump[256];
 #endif
+ unsigned i;
 
-#ifdef _I8051_FORCE_END_
- fprintf(stdout, "ACC:   %04lx\n",
-         static_cast<unsigned long>(IRAM.read(ACC)));
- fprintf(stdout, "PSW:   %04lx\n",
-         static_cast<unsigned long>(IRAM.read(PSW)));
- fprintf(stdout, "B:     %04lx\n",
-         static_cast<unsigned long>(IRAM.read(B)));
- fprintf(stdout, "DPTRH: %04lx\n",
-         static_cast<unsigned long>(IRAM.read(DPTRH)));
- fprintf(stdout, "DPTRL: %04lx\n",
-         static_cast<unsigned long>(IRAM.read(DPTRL)));
- fprintf(stdout, "SP:    %04lx\n",
-         static_cast<unsigned long>(IRAM.read(SP)));
-#endif
+ IRAM.write(PSW, psw_read());
+ if (timer2 != NULL)
+  for (i = I8051_RCAP2L; i <= I8051_TH2; i++)
+   IRAM.write(i, timer2->read(i, cycles));
 #ifdef _I8051_DUMP_MEMORY_
  filename = new char[40];
  sprintf(filename, "iram.%x.%lu.dump", ac_pc.read(), ac_instr_counter);
- memdump(filename, IRAM);
+ mem_read(I8051_MEM_DIRECT, 0, dump, 256);
+ memdump(filename, dump, 256);
+ if (i8051_traits::iram_size > 128)
+ {
+  sprintf(filename, "idata.%x.%lu.dump", ac_pc.read(), ac_instr_counter);
+  memset(dump, 0, 0x80);
+  mem_read(I8051_MEM_IDATA, 0x80, dump + 0x80, 0x80);
+  memdump(filename, dump, 256);
+ }
  sprintf(filename, "iramx.%x.%lu.dump", ac_pc.read(), ac_instr_counter);
- memdump(filename, IRAMX);
+ memdump(filename, xdata->ram, sizeof(xdata->ram));
  sprintf(filename, "irom.%x.%lu.dump", ac_pc.read(), ac_instr_counter);
- memdump(filename, IROM);
+ memdump(filename, irom, 0x10000);
  delete[] filename;
 #endif
+ stats->insts = insts;
+ stats->cycles = cycles;
+ stats->seconds = i8051_host_time() - host_start;
+ stats->pc = ac_pc.read();
+ stats->a = IRAM.read(ACC);
+ stats->b = IRAM.read(B);
+ stats->psw = IRAM.read(PSW);
+ stats->sp = IRAM.read(SP);
+ // DPTRH/DPTRL add dptr_index(): the DPTR selected by DPS.
+ stats->dptr = (IRAM.read(DPTRH) << 8) | IRAM.read(DPTRL);
+ for (i = 0; i < 256; i++)
+  stats->op_cycles[i] = stats->exec[i] * i8051_traits::op_cycles(i);
+ i8051_stats_write(stats);
+ delete stats;
+ i8051_live_close(live, cycles);
+ if (cosim != NULL)
+ {
+  cosim_fill();
+  i8051_cosim_finish(cosim, cycles);
+  delete cosim;
+ }
+ i8051_stackcheck_close(stackchk);
+ i8051_watch_close(watch);
+ delete watch;
+ delete ports;
+ delete timer2;
+ delete extint;
+ i8051_xdata_destroy(xdata);
+ delete xdata;
+ delete sched;
+ delete[] irom;
  return;
 }
 
@@ -104,6 +758,33 @@ void ac_behavior(instruction)
  else
   pc_stability = 0;
 #endif
+ if (cycles >= sched->next)
+  i8051_sched_run(sched, cycles);
+ inst_pc = ac_pc.read();
+ if (irq_check)
+ {
+  if (irq_hold)
+   irq_hold = false;
+  else if (irq_dispatch())
+  {
+   ac_annul();
+   return;
+  }
+ }
+ if (cosim != NULL)
+ {
+  cosim_fill();
+  if (!i8051_cosim_compare(cosim, cycles))
+  {
+   delete cosim;
+   cosim = NULL;
+   stop(1);
+   ac_annul();
+   return;
+  }
+  i8051_cosim_step(cosim);
+ }
+ insts++;
  ac_pc += get_size();
  pc = ac_pc.read();
 #ifdef _I8051_FORCE_END_
@@ -115,14 +796,23 @@ void ac_behavior(instruction)
  return;
 }
 
+//! Cycles and execution count of the opcode being executed.
+inline void i8051_isa::count_op(unsigned opc)
+{
+ cycles += i8051_traits::op_cycles(opc);
+ stats->exec[opc]++;
+}
+
 //! Instruction Format behavior methods.
 void ac_behavior(Type_3bytes)
 {
+ count_op(op);
  return;
 }
 
 void ac_behavior(Type_2bytes)
 {
+ count_op(op);
  return;
 }
 
@@ -130,6 +820,7 @@ void ac_behavior(Type_OP_R)
 {
  sc_uint<8> psw = IRAM.read(PSW);
 
+ count_op((op1 << 3) | reg);
  if (psw.range(4, 3) == 0)
   reg_indx = reg;
  else if (psw.range(4, 3) == 1)
@@ -143,11 +834,13 @@ void ac_behavior(Type_OP_R)
 
 void ac_behavior(Type_IBRCH)
 {
+ count_op((page << 5) | op2);
  return;
 }
 
 void ac_behavior(Type_1byte)
 {
+ count_op(op);
  return;
 }
 
@@ -155,6 +848,7 @@ void ac_behavior(Type_3bytesReg)
 {
  sc_uint<8> psw = IRAM.read(PSW);
 
+ count_op((op3 << 3) | reg2);
  if (psw.range(4, 3) == 0)
   reg_indx = reg2;
  else if (psw.range(4, 3) == 1)
@@ -170,6 +864,7 @@ void ac_behavior(Type_2bytesReg)
 {
  sc_uint<8> psw = IRAM.read(PSW);
 
+ count_op((op3 << 3) | reg2);
  if (psw.range(4, 3) == 0)
   reg_indx = reg2;
  else if (psw.range(4, 3) == 1)
@@ -211,11 +906,11 @@ void ac_behavior(xch_arr_R0)
   reg_indx = 16;
  else
   reg_indx = 24;
- data = IRAM.read(IRAM.read(reg_indx));
+ data = ind_read(IRAM.read(reg_indx));
  temp = acc;
  acc = data;
  data = temp;
- IRAM.write(IRAM.read(reg_indx), data);
+ ind_write(IRAM.read(reg_indx), data);
  IRAM.write(ACC, acc);
  return;
 }
@@ -235,11 +930,11 @@ void ac_behavior(xch_arr_R1)
   reg_indx = 17;
  else
   reg_indx = 25;
- data = IRAM.read(IRAM.read(reg_indx));
+ data = ind_read(IRAM.read(reg_indx));
  temp = acc;
  acc = data;
  data = temp;
- IRAM.write(IRAM.read(reg_indx), data);
+ ind_write(IRAM.read(reg_indx), data);
  IRAM.write(ACC, acc);
  return;
 }
@@ -249,11 +944,11 @@ void ac_behavior(xch_a_iram)
  sc_uint<8> acc, temp, data;
 
  acc = IRAM.read(ACC);
- data = IRAM.read(byte2);
+ data = direct_read(byte2);
  temp = acc;
  acc = data;
  data = temp;
- IRAM.write(byte2, data);
+ direct_write(byte2, data);
  IRAM.write(ACC, acc);
  return;
 }
@@ -269,7 +964,7 @@ void ac_behavior(jb)
   addr = aux.range(6, 3) + 32;
  else
   addr = aux.range(6, 3) * 8 + 128;
- data = IRAM.read(addr);
+ data = direct_read(addr);
  if (data[aux.range(2, 0)] == 1)
   ac_pc = pc + tempByte3;
  return;
@@ -286,7 +981,7 @@ void ac_behavior(jnb)
   addr = aux.range(6, 3) + 32;
  else
   addr = aux.range(6, 3) * 8 + 128;
- data = IRAM.read(addr);
+ data = direct_read(addr);
  if (data[aux.range(2, 0)] == 0)
   ac_pc = pc + tempByte3;
  return;
@@ -304,12 +999,12 @@ void ac_behavior(jbc)
   addr = aux.range(6, 3) + 32;
  else
   addr = aux.range(6, 3) * 8 + 128;
- data = IRAM.read(addr);
+ data = latch_read(addr);
  if (data[aux.range(2, 0)] == 1)
  {
   ac_pc = pc + tempByte3;
   data[aux.range(2, 0)] = 0;
-  IRAM.write(addr, data);
+  direct_write(addr, data);
  }
  return;
 }
@@ -346,7 +1041,7 @@ void ac_behavior(jmp)
  dptr.range(7, 0) = IRAM.read(DPTRL);
  dptr.range(15, 8) = IRAM.read(DPTRH);
  acc = IRAM.read(ACC);
- pc = acc + dptr;
+ pc = (acc + dptr) & 0xFFFF;
  ac_pc = pc;
  return;
 }
@@ -401,10 +1096,10 @@ void ac_behavior(setb_bit)
   addr = aux.range(6, 3) + 32;
  else
   addr = aux.range(6, 3) * 8 + 128;
- data = IRAM.read(addr);
+ data = latch_read(addr);
  if (data[aux.range(2, 0)] == 0)
   data[aux.range(2, 0)] = 1;
- IRAM.write(addr, data);
+ direct_write(addr, data);
  return;
 }
 
@@ -431,14 +1126,14 @@ void ac_behavior(djnz_iram_reladd)
  sc_int<8> tempByte3 = (sc_int<8>) byte3;
 
  psw = IRAM.read(PSW);
- aux = IRAM.read(byte2);
+ aux = latch_read(byte2);
  if (aux != 0)
   aux = aux - 1;
  else
   aux = 255;
  if (aux != 0)
   ac_pc = (pc + tempByte3);
- IRAM.write(byte2, aux);
+ direct_write(byte2, aux);
  return;
 }
 
@@ -446,11 +1141,15 @@ void ac_behavior(lcall)
 {
  sc_uint<9> aux;
 
+ if (stackchk != NULL &&
+     i8051_stackcheck_call(stackchk, false, inst_pc, (byte2 << 8) | byte3,
+                           IRAM.read(SP), IRAM.read(PSW), cycles))
+  stop(1);
  aux = IRAM.read(SP) + 1;
- IRAM.write(aux.range(7, 0), pc.range(7, 0));
+ ind_write(aux.range(7, 0), pc.range(7, 0));
  IRAM.write(SP, aux.range(7, 0));
  aux = IRAM.read(SP) + 1;
- IRAM.write(aux.range(7, 0), pc.range(15, 8));
+ ind_write(aux.range(7, 0), pc.range(15, 8));
  IRAM.write(SP, aux.range(7, 0));
  pc.range(7, 0) = byte3;
  pc.range(15, 8) = byte2;
@@ -471,6 +1170,11 @@ void ac_behavior(sjmp)
  sc_int<8> tempByte2 = (sc_int<8>) byte2;
 
  ac_pc = pc + tempByte2;
+ // With I8051_HALT, "sjmp $" with nothing left to wake the core ends
+ // the simulation; a request already pending is taken first.
+ if (tempByte2 == -2 && halt && !irq_check && !irq_pending() &&
+     (!(IRAM.read(IE) & 0x80) || sched->next == I8051_NEVER))
+  stop(0);
  return;
 }
 
@@ -501,12 +1205,12 @@ void ac_behavior(xchd_R0)
   reg_indx = 16;
  else
   reg_indx = 24;
- temp = IRAM.read(IRAM.read(reg_indx));
+ temp = ind_read(IRAM.read(reg_indx));
  aux = temp;
  temp.range(3, 0) = acc.range(3, 0);
  acc.range(3, 0) = aux.range(3, 0);
  IRAM.write(ACC, acc);
- IRAM.write(IRAM.read(reg_indx), temp);
+ ind_write(IRAM.read(reg_indx), temp);
  return;
 }
 
@@ -525,12 +1229,12 @@ void ac_behavior(xchd_R1)
   reg_indx = 17;
  else
   reg_indx = 25;
- temp = IRAM.read(IRAM.read(reg_indx));
+ temp = ind_read(IRAM.read(reg_indx));
  aux = temp;
  temp.range(3, 0) = acc.range(3, 0);
  acc.range(3, 0) = aux.range(3, 0);
  IRAM.write(ACC, acc);
- IRAM.write(IRAM.read(reg_indx), temp);
+ ind_write(IRAM.read(reg_indx), temp);
  return;
 }
 
@@ -638,7 +1342,7 @@ void ac_behavior(add_a_iram)
  psw[7] = 0;                    //clear carry bit
  psw[6] = 0;                    //clear nibble carry
  sum = 0;
- aux = IRAM.read(byte2);
+ aux = direct_read(byte2);
  //checking overflow
  sum = acc.range(6, 0) + aux.range(6, 0);
  bit7 = sum[7];
@@ -658,7 +1362,7 @@ void ac_behavior(add_a_iram)
  sum = acc + aux;               //sum all
  if (sum[8])
   psw[7] = 1;
- sum = IRAM.read(ACC) + IRAM.read(byte2);
+ sum = IRAM.read(ACC) + direct_read(byte2);
  IRAM.write(PSW, psw);
  IRAM.write(ACC, sum.range(7, 0));
  return;
@@ -687,7 +1391,7 @@ void ac_behavior(add_arr_R0)
  psw[7] = 0;                    //clear carry bit
  psw[6] = 0;                    //clear nibble carry
  sum = 0;
- aux = IRAM.read(IRAM.read(reg_indx));
+ aux = ind_read(IRAM.read(reg_indx));
  //checking overflow
  sum = acc.range(6, 0) + aux.range(6, 0);
  bit7 = sum[7];
@@ -707,7 +1411,7 @@ void ac_behavior(add_arr_R0)
  sum = acc + aux;               //sum all
  if (sum[8])
   psw[7] = 1;
- sum = IRAM.read(IRAM.read(reg_indx)) + IRAM.read(ACC);
+ sum = ind_read(IRAM.read(reg_indx)) + IRAM.read(ACC);
  IRAM.write(PSW, psw);
  IRAM.write(ACC, sum.range(7, 0));
  return;
@@ -736,7 +1440,7 @@ void ac_behavior(add_arr_R1)
  psw[7] = 0;                    //clear carry bit
  psw[6] = 0;                    //clear nibble carry
  sum = 0;
- aux = IRAM.read(IRAM.read(reg_indx));
+ aux = ind_read(IRAM.read(reg_indx));
  //checking overflow
  sum = acc.range(6, 0) + aux.range(6, 0);
  bit7 = sum[7];
@@ -756,7 +1460,7 @@ void ac_behavior(add_arr_R1)
  sum = acc + aux;               //sum all
  if (sum[8])
   psw[7] = 1;
- sum = IRAM.read(IRAM.read(reg_indx)) + IRAM.read(ACC);
+ sum = ind_read(IRAM.read(reg_indx)) + IRAM.read(ACC);
  IRAM.write(PSW, psw);
  IRAM.write(ACC, sum.range(7, 0));
  return;
@@ -791,7 +1495,7 @@ void ac_behavior(addc_ar)
  }
  //checking auxiliary carry
  sum = 0;
- sum = acc.range(3, 0) + aux.range(3, 0); // sum nibble
+ sum = acc.range(3, 0) + aux.range(3, 0) + psw[7]; // sum nibble and carry
  if (sum[4])
   psw[6] = 1;
  else
@@ -836,7 +1540,7 @@ void ac_behavior(addc_a_data)
  }
  //checking auxiliary carry
  sum = 0;
- sum = acc.range(3, 0) + aux.range(3, 0); // sum nibble
+ sum = acc.range(3, 0) + aux.range(3, 0) + psw[7]; // sum nibble and carry
  if (sum[4])
   psw[6] = 1;
  else
@@ -861,8 +1565,8 @@ void ac_behavior(addc_a_iram)
 
  psw = IRAM.read(PSW);
  acc = IRAM.read(ACC);
- aux = IRAM.read(byte2);
- sum = IRAM.read(ACC) + IRAM.read(byte2) + psw[7];
+ aux = direct_read(byte2);
+ sum = IRAM.read(ACC) + direct_read(byte2) + psw[7];
  IRAM.write(ACC, sum.range(7, 0));
  //checking overflow
  psw[2] = 0;                    // clear Overflow bit
@@ -881,7 +1585,7 @@ void ac_behavior(addc_a_iram)
  }
  //checking auxiliary carry
  sum = 0;
- sum = acc.range(3, 0) + aux.range(3, 0); // sum nibble
+ sum = acc.range(3, 0) + aux.range(3, 0) + psw[7]; // sum nibble and carry
  if (sum[4])
   psw[6] = 1;
  else
@@ -915,8 +1619,8 @@ void ac_behavior(addc_arr_R0)
   reg_indx = 16;
  else
   reg_indx = 24;
- aux = IRAM.read(IRAM.read(reg_indx));
- sum = IRAM.read(IRAM.read(reg_indx)) + IRAM.read(ACC) + psw[7];
+ aux = ind_read(IRAM.read(reg_indx));
+ sum = ind_read(IRAM.read(reg_indx)) + IRAM.read(ACC) + psw[7];
  IRAM.write(ACC, sum.range(7, 0));
  //checking overflow
  psw[2] = 0;                    // clear Overflow bit
@@ -935,7 +1639,7 @@ void ac_behavior(addc_arr_R0)
  }
  //checking auxiliary carry
  sum = 0;
- sum = acc.range(3, 0) + aux.range(3, 0); // sum nibble
+ sum = acc.range(3, 0) + aux.range(3, 0) + psw[7]; // sum nibble and carry
  if (sum[4])
   psw[6] = 1;
  else
@@ -969,8 +1673,8 @@ void ac_behavior(addc_arr_R1)
   reg_indx = 17;
  else
   reg_indx = 25;
- aux = IRAM.read(IRAM.read(reg_indx));
- sum = IRAM.read(IRAM.read(reg_indx)) + IRAM.read(ACC) + psw[7];
+ aux = ind_read(IRAM.read(reg_indx));
+ sum = ind_read(IRAM.read(reg_indx)) + IRAM.read(ACC) + psw[7];
  IRAM.write(ACC, sum.range(7, 0));
  //checking overflow
  psw[2] = 0;                    // clear Overflow bit
@@ -989,7 +1693,7 @@ void ac_behavior(addc_arr_R1)
  }
  //checking auxiliary carry
  sum = 0;
- sum = acc.range(3, 0) + aux.range(3, 0); // sum nibble
+ sum = acc.range(3, 0) + aux.range(3, 0) + psw[7]; // sum nibble and carry
  if (sum[4])
   psw[6] = 1;
  else
@@ -1025,11 +1729,10 @@ void ac_behavior(subb_ar)
  if (acc.range(6, 0) < (aux.range(6, 0) + psw[7]))
   borrow6 = true;
  psw[2] = borrow7 ^ borrow6;
+ //checking auxiliary carry (borrow from bit 4)
+ psw[6] = acc.range(3, 0) < (aux.range(3, 0) + psw[7]);
  //checking borrow (carry)
  psw[7] = borrow7;
- //checking auxiliary carry
- if (aux.range(3, 0) > (acc.range(3, 0) + psw[7]))
-  psw[6] = 1;
  IRAM.write(PSW, psw);
  return;
 }
@@ -1048,14 +1751,13 @@ void ac_behavior(subb_a_data)
  bool borrow6 = false;
  if (acc < (aux + psw[7]))
   borrow7 = true;
- if (acc.range(6, 0) < (aux.range(6, 0) + psw[1]))
+ if (acc.range(6, 0) < (aux.range(6, 0) + psw[7]))
   borrow6 = true;
  psw[2] = borrow7 ^ borrow6;
+ //checking auxiliary carry (borrow from bit 4)
+ psw[6] = acc.range(3, 0) < (aux.range(3, 0) + psw[7]);
  //checking borrow (carry)
  psw[7] = borrow7;
- //checking auxiliary carry
- if (aux.range(3, 0) > (acc.range(3, 0) + psw[7]))
-  psw[6] = 1;
  IRAM.write(PSW, psw);
  return;
 }
@@ -1063,7 +1765,7 @@ void ac_behavior(subb_a_data)
 void ac_behavior(subb_a_iram)
 {
  sc_uint<9> sub;
- sc_uint<8> aux = IRAM.read(byte2);
+ sc_uint<8> aux = direct_read(byte2);
  sc_uint<8> acc = IRAM.read(ACC);
  sc_uint<8> psw = IRAM.read(PSW);
 
@@ -1077,11 +1779,10 @@ void ac_behavior(subb_a_iram)
  if (acc.range(6, 0) < (aux.range(6, 0) + psw[7]))
   borrow6 = true;
  psw[2] = borrow7 ^ borrow6;
+ //checking auxiliary carry (borrow from bit 4)
+ psw[6] = acc.range(3, 0) < (aux.range(3, 0) + psw[7]);
  //checking borrow (carry)
  psw[7] = borrow7;
- //checking auxiliary carry
- if (aux.range(3, 0) > (acc.range(3, 0) + psw[7]))
-  psw[6] = 1;
  IRAM.write(PSW, psw);
  return;
 }
@@ -1102,7 +1803,7 @@ void ac_behavior(subb_a_arr_R0)
   reg_indx = 16;
  else
   reg_indx = 24;
- aux = IRAM.read(IRAM.read(reg_indx));
+ aux = ind_read(IRAM.read(reg_indx));
  sub = acc - (aux + psw[7]);
  IRAM.write(ACC, sub.range(7, 0));
  //checking overflow
@@ -1113,11 +1814,10 @@ void ac_behavior(subb_a_arr_R0)
  if (acc.range(6, 0) < (aux.range(6, 0) + psw[7]))
   borrow6 = true;
  psw[2] = borrow7 ^ borrow6;
+ //checking auxiliary carry (borrow from bit 4)
+ psw[6] = acc.range(3, 0) < (aux.range(3, 0) + psw[7]);
  //checking borrow (carry)
  psw[7] = borrow7;
- //checking auxiliary carry
- if (aux.range(3, 0) > (acc.range(3, 0) + psw[7]))
-  psw[6] = 1;
  IRAM.write(PSW, psw);
  return;
 }
@@ -1138,7 +1838,7 @@ void ac_behavior(subb_a_arr_R1)
   reg_indx = 17;
  else
   reg_indx = 25;
- aux = IRAM.read(IRAM.read(reg_indx));
+ aux = ind_read(IRAM.read(reg_indx));
  sub = acc - (aux + psw[7]);
  IRAM.write(ACC, sub.range(7, 0));
  //checking overflow
@@ -1148,11 +1848,10 @@ void ac_behavior(subb_a_arr_R1)
  if (acc.range(6, 0) < (aux.range(6, 0) + psw[7]))
   borrow6 = true;
  psw[2] = borrow7 ^ borrow6;
+ //checking auxiliary carry (borrow from bit 4)
+ psw[6] = acc.range(3, 0) < (aux.range(3, 0) + psw[7]);
  //checking borrow (carry)
  psw[7] = borrow7;
- //checking auxiliary carry
- if (aux.range(3, 0) > (acc.range(3, 0) + psw[7]))
-  psw[6] = 1;
  IRAM.write(PSW, psw);
  return;
 }
@@ -1171,7 +1870,7 @@ void ac_behavior(mov_arr_R0_data)
   reg_indx = 16;
  else
   reg_indx = 24;
- IRAM.write(IRAM.read(reg_indx), byte2);
+ ind_write(IRAM.read(reg_indx), byte2);
  return;
 }
 
@@ -1189,7 +1888,7 @@ void ac_behavior(mov_arr_R1_data)
   reg_indx = 17;
  else
   reg_indx = 25;
- IRAM.write(IRAM.read(reg_indx), byte2);
+ ind_write(IRAM.read(reg_indx), byte2);
  return;
 }
 
@@ -1207,7 +1906,7 @@ void ac_behavior(mov_arr_R0_a)
   reg_indx = 16;
  else
   reg_indx = 24;
- IRAM.write(IRAM.read(reg_indx), IRAM.read(ACC));
+ ind_write(IRAM.read(reg_indx), IRAM.read(ACC));
  return;
 }
 
@@ -1225,7 +1924,7 @@ void ac_behavior(mov_arr_R1_a)
   reg_indx = 17;
  else
   reg_indx = 25;
- IRAM.write(IRAM.read(reg_indx), IRAM.read(ACC));
+ ind_write(IRAM.read(reg_indx), IRAM.read(ACC));
  return;
 }
 
@@ -1243,7 +1942,7 @@ void ac_behavior(mov_arr_R0_iram)
   reg_indx = 16;
  else
   reg_indx = 24;
- IRAM.write(IRAM.read(reg_indx), IRAM.read(byte2));
+ ind_write(IRAM.read(reg_indx), direct_read(byte2));
  return;
 }
 
@@ -1261,7 +1960,7 @@ void ac_behavior(mov_arr_R1_iram)
   reg_indx = 17;
  else
   reg_indx = 25;
- IRAM.write(IRAM.read(reg_indx), IRAM.read(byte2));
+ ind_write(IRAM.read(reg_indx), direct_read(byte2));
  return;
 }
 
@@ -1278,7 +1977,7 @@ void ac_behavior(mov_iram_arr_R0)
   reg_indx = 16;
  else
   reg_indx = 24;
- IRAM.write(byte2, IRAM.read(IRAM.read(reg_indx)));
+ direct_write(byte2, ind_read(IRAM.read(reg_indx)));
  return;
 }
 
@@ -1295,7 +1994,7 @@ void ac_behavior(mov_iram_arr_R1)
   reg_indx = 17;
  else
   reg_indx = 25;
- IRAM.write(byte2, IRAM.read(IRAM.read(reg_indx)));
+ direct_write(byte2, ind_read(IRAM.read(reg_indx)));
  return;
 }
 
@@ -1318,7 +2017,7 @@ void ac_behavior(mov_a_arr_R0)
   reg_indx = 16;
  else
   reg_indx = 24;
- IRAM.write(ACC, IRAM.read(IRAM.read(reg_indx)));
+ IRAM.write(ACC, ind_read(IRAM.read(reg_indx)));
  return;
 }
 
@@ -1336,7 +2035,7 @@ void ac_behavior(mov_a_arr_R1)
   reg_indx = 17;
  else
   reg_indx = 25;
- IRAM.write(ACC, IRAM.read(IRAM.read(reg_indx)));
+ IRAM.write(ACC, ind_read(IRAM.read(reg_indx)));
  return;
 }
 
@@ -1348,13 +2047,13 @@ void ac_behavior(mov_ar)
 
 void ac_behavior(mov_a_iram)
 {
- IRAM.write(ACC, IRAM.read(byte2));
+ IRAM.write(ACC, direct_read(byte2));
  return;
 }
 
 void ac_behavior(mov_iram_a)
 {
- IRAM.write(byte2, IRAM.read(ACC));
+ direct_write(byte2, IRAM.read(ACC));
  return;
 }
 
@@ -1369,7 +2068,7 @@ void ac_behavior(mov_c_bit)
   addr = aux.range(6, 3) + 32;
  else
   addr = aux.range(6, 3) * 8 + 128;
- data = IRAM.read(addr);
+ data = direct_read(addr);
  psw[7] = data[aux.range(2, 0)];
  IRAM.write(PSW, psw);
  return;
@@ -1386,15 +2085,15 @@ void ac_behavior(mov_bit_c)
   addr = aux.range(6, 3) + 32;
  else
   addr = aux.range(6, 3) * 8 + 128;
- data = IRAM.read(addr);
+ data = latch_read(addr);
  data[aux.range(2, 0)] = psw[7];
- IRAM.write(addr, data);
+ direct_write(addr, data);
  return;
 }
 
 void ac_behavior(mov_iram_data)
 {
- IRAM.write(byte2, byte3);
+ direct_write(byte2, byte3);
  return;
 }
 
@@ -1413,13 +2112,13 @@ void ac_behavior(mov_r_data)
 
 void ac_behavior(mov_r_iram)
 {
- IRAM.write(reg_indx, IRAM.read(addr));
+ IRAM.write(reg_indx, direct_read(addr));
  return;
 }
 
 void ac_behavior(mov_iram_r)
 {
- IRAM.write(addr, IRAM.read(reg_indx));
+ direct_write(addr, IRAM.read(reg_indx));
  return;
 }
 
@@ -1431,7 +2130,7 @@ void ac_behavior(mov_ra)
 
 void ac_behavior(mov_iram_iram)
 {
- IRAM.write(byte3, IRAM.read(byte2));
+ direct_write(byte3, direct_read(byte2));
  return;
 }
 
@@ -1443,7 +2142,8 @@ void ac_behavior(movc_dptr)
  dptr.range(7, 0) = IRAM.read(DPTRL);
  dptr.range(15, 8) = IRAM.read(DPTRH);
  acc = IRAM.read(ACC);
- IRAM.write(ACC, IROM.read(acc + dptr));
+ stats->reads[I8051_ACC_CODE]++;
+ IRAM.write(ACC, irom[(acc + dptr) & 0xFFFF]);
  return;
 }
 
@@ -1451,7 +2151,8 @@ void ac_behavior(movc_pc)
 {
  sc_uint<16> pc = (sc_uint<16>) ac_pc.read();
  sc_uint<8> acc = (sc_uint<8>) IRAM.read(ACC);
- IRAM.write(ACC, IROM.read(acc + pc));
+ stats->reads[I8051_ACC_CODE]++;
+ IRAM.write(ACC, irom[(acc + pc) & 0xFFFF]);
  return;
 }
 
@@ -1459,11 +2160,16 @@ void ac_behavior(acall)
 {
  sc_uint<9> aux;
 
+ if (stackchk != NULL &&
+     i8051_stackcheck_call(stackchk, false, inst_pc,
+                           (pc & 0xF800) | (page << 8) | addr0,
+                           IRAM.read(SP), IRAM.read(PSW), cycles))
+  stop(1);
  aux = IRAM.read(SP) + 1;
- IRAM.write(aux.range(7, 0), pc.range(7, 0));
+ ind_write(aux.range(7, 0), pc.range(7, 0));
  IRAM.write(SP, aux.range(7, 0));
  aux = IRAM.read(SP) + 1;
- IRAM.write(aux.range(7, 0), pc.range(15, 8));
+ ind_write(aux.range(7, 0), pc.range(15, 8));
  IRAM.write(SP, aux.range(7, 0));
  pc.range(10, 8) = page;
  pc.range(7, 0) = addr0;
@@ -1486,9 +2192,9 @@ void ac_behavior(cjne_addr)
 
  psw = IRAM.read(PSW);
  acc = IRAM.read(ACC);
- if (acc != (unsigned) IRAM.read(byte2))
+ if (acc != (unsigned) direct_read(byte2))
   ac_pc = (pc + tempByte3);
- if (IRAM.read(ACC) < IRAM.read(byte2))
+ if (IRAM.read(ACC) < direct_read(byte2))
   psw[7] = 1;
  else
   psw[7] = 0;
@@ -1527,9 +2233,9 @@ void ac_behavior(cjne_arr_R0)
   reg_indx = 16;
  else
   reg_indx = 24;
- if (IRAM.read(IRAM.read(reg_indx)) != byte2)
+ if (ind_read(IRAM.read(reg_indx)) != byte2)
   ac_pc = (pc + tempByte3);
- if (IRAM.read(IRAM.read(reg_indx)) < byte2)
+ if (ind_read(IRAM.read(reg_indx)) < byte2)
   psw[7] = 1;
  else
   psw[7] = 0;
@@ -1551,9 +2257,9 @@ void ac_behavior(cjne_arr_R1)
   reg_indx = 17;
  else
   reg_indx = 25;
- if (IRAM.read(IRAM.read(reg_indx)) != byte2)
+ if (ind_read(IRAM.read(reg_indx)) != byte2)
   ac_pc = (pc + tempByte3);
- if (IRAM.read(IRAM.read(reg_indx)) < byte2)
+ if (ind_read(IRAM.read(reg_indx)) < byte2)
   psw[7] = 1;
  else
   psw[7] = 0;
@@ -1587,9 +2293,9 @@ void ac_behavior(clr_bit)
   addr = aux.range(6, 3) + 32;
  else
   addr = aux.range(6, 3) * 8 + 128;
- data = IRAM.read(addr);
+ data = latch_read(addr);
  data[aux.range(2, 0)] = 0;
- IRAM.write(addr, data);
+ direct_write(addr, data);
  return;
 }
 
@@ -1615,10 +2321,10 @@ void ac_behavior(pop)
  unsigned idx;
 
  idx = IRAM.read(SP);
- value = IRAM.read(idx);
+ value = ind_read(idx);
  idx = idx - 1;
  IRAM.write(SP, idx);
- IRAM.write(byte2, value);
+ direct_write(byte2, value);
  return;
 }
 
@@ -1626,9 +2332,13 @@ void ac_behavior(push)
 {
  sc_uint<8> stack = IRAM.read(SP);
 
+ if (stackchk != NULL &&
+     i8051_stackcheck_write(stackchk, "push", inst_pc, stack + 1,
+                            IRAM.read(PSW), cycles))
+  stop(1);
  stack = stack + 1;
  IRAM.write(SP, stack);
- IRAM.write(stack, IRAM.read(byte2));
+ ind_write(stack, direct_read(byte2));
  return;
 }
 
@@ -1636,10 +2346,10 @@ void ac_behavior(anl_iram_data)
 {
  sc_uint<8> aux, data;
 
- aux = IRAM.read(byte2);
+ aux = latch_read(byte2);
  data = byte3;
  aux = aux & data;
- IRAM.write(byte2, aux);
+ direct_write(byte2, aux);
  return;
 }
 
@@ -1647,10 +2357,10 @@ void ac_behavior(orl_iram_data)
 {
  sc_uint<8> aux, data;
 
- aux = IRAM.read(byte2);
+ aux = latch_read(byte2);
  data = byte3;
  aux = aux | data;
- IRAM.write(byte2, aux);
+ direct_write(byte2, aux);
  return;
 }
 
@@ -1658,10 +2368,10 @@ void ac_behavior(xrl_iram_data)
 {
  sc_uint<8> aux, data;
 
- aux = IRAM.read(byte2);
+ aux = latch_read(byte2);
  data = byte3;
  aux = aux ^ data;
- IRAM.write(byte2, aux);
+ direct_write(byte2, aux);
  return;
 }
 
@@ -1670,9 +2380,9 @@ void ac_behavior(anl_iram_a)
  sc_uint<8> aux, acc;
 
  acc = IRAM.read(ACC);
- aux = IRAM.read(byte2);
+ aux = latch_read(byte2);
  aux = aux & acc;
- IRAM.write(byte2, aux);
+ direct_write(byte2, aux);
  return;
 }
 
@@ -1681,9 +2391,9 @@ void ac_behavior(orl_iram_a)
  sc_uint<8> aux, acc;
 
  acc = IRAM.read(ACC);
- aux = IRAM.read(byte2);
+ aux = latch_read(byte2);
  aux = aux | acc;
- IRAM.write(byte2, aux);
+ direct_write(byte2, aux);
  return;
 }
 
@@ -1692,9 +2402,9 @@ void ac_behavior(xrl_iram_a)
  sc_uint<8> aux, acc;
 
  acc = IRAM.read(ACC);
- aux = IRAM.read(byte2);
+ aux = latch_read(byte2);
  aux = aux ^ acc;
- IRAM.write(byte2, aux);
+ direct_write(byte2, aux);
  return;
 }
 
@@ -1736,7 +2446,7 @@ void ac_behavior(anl_a_iram)
  sc_uint<8> aux, acc;
 
  acc = IRAM.read(ACC);
- aux = IRAM.read(byte2);
+ aux = direct_read(byte2);
  aux = aux & acc;
  IRAM.write(ACC, aux);
  return;
@@ -1747,7 +2457,7 @@ void ac_behavior(orl_a_iram)
  sc_uint<8> aux, acc;
 
  acc = IRAM.read(ACC);
- aux = IRAM.read(byte2);
+ aux = direct_read(byte2);
  aux = aux | acc;
  IRAM.write(ACC, aux);
  return;
@@ -1758,7 +2468,7 @@ void ac_behavior(xrl_a_iram)
  sc_uint<8> aux, acc;
 
  acc = IRAM.read(ACC);
- aux = IRAM.read(byte2);
+ aux = direct_read(byte2);
  aux = aux ^ acc;
  IRAM.write(ACC, aux);
  return;
@@ -1769,6 +2479,7 @@ void ac_behavior(anl_arr_R0)
  sc_uint<8> tmpA, acc, psw;
 
  acc = IRAM.read(ACC);
+ psw = IRAM.read(PSW);
  if (psw.range(4, 3) == 0)
   reg_indx = 0;
  else if (psw.range(4, 3) == 1)
@@ -1777,7 +2488,7 @@ void ac_behavior(anl_arr_R0)
   reg_indx = 16;
  else
   reg_indx = 24;
- tmpA = IRAM.read(IRAM.read(reg_indx));
+ tmpA = ind_read(IRAM.read(reg_indx));
  tmpA = tmpA & acc;
  IRAM.write(ACC, tmpA);
  return;
@@ -1788,6 +2499,7 @@ void ac_behavior(anl_arr_R1)
  sc_uint<8> tmpA, acc, psw;
  int reg_indx;
 
+ psw = IRAM.read(PSW);
  if (psw.range(4, 3) == 0)
   reg_indx = 1;
  else if (psw.range(4, 3) == 1)
@@ -1797,7 +2509,7 @@ void ac_behavior(anl_arr_R1)
  else
   reg_indx = 25;
  acc = IRAM.read(ACC);
- tmpA = IRAM.read(IRAM.read(reg_indx));
+ tmpA = ind_read(IRAM.read(reg_indx));
  tmpA = tmpA & acc;
  IRAM.write(ACC, tmpA);
  return;
@@ -1808,6 +2520,7 @@ void ac_behavior(orl_arr_R0)
  sc_uint<8> tmpA, acc, psw;
 
  acc = IRAM.read(ACC);
+ psw = IRAM.read(PSW);
  if (psw.range(4, 3) == 0)
   reg_indx = 0;
  else if (psw.range(4, 3) == 1)
@@ -1816,7 +2529,7 @@ void ac_behavior(orl_arr_R0)
   reg_indx = 16;
  else
   reg_indx = 24;
- tmpA = IRAM.read(IRAM.read(reg_indx));
+ tmpA = ind_read(IRAM.read(reg_indx));
  tmpA = tmpA | acc;
  IRAM.write(ACC, tmpA);
  return;
@@ -1827,6 +2540,7 @@ void ac_behavior(orl_arr_R1)
  sc_uint<8> tmpA, acc, psw;
  int reg_indx;
 
+ psw = IRAM.read(PSW);
  if (psw.range(4, 3) == 0)
   reg_indx = 1;
  else if (psw.range(4, 3) == 1)
@@ -1836,7 +2550,7 @@ void ac_behavior(orl_arr_R1)
  else
   reg_indx = 25;
  acc = IRAM.read(ACC);
- tmpA = IRAM.read(IRAM.read(reg_indx));
+ tmpA = ind_read(IRAM.read(reg_indx));
  tmpA = tmpA | acc;
  IRAM.write(ACC, tmpA);
  return;
@@ -1847,6 +2561,7 @@ void ac_behavior(xrl_arr_R0)
  sc_uint<8> tmpA, acc, psw;
 
  acc = IRAM.read(ACC);
+ psw = IRAM.read(PSW);
  if (psw.range(4, 3) == 0)
   reg_indx = 0;
  else if (psw.range(4, 3) == 1)
@@ -1855,7 +2570,7 @@ void ac_behavior(xrl_arr_R0)
   reg_indx = 16;
  else
   reg_indx = 24;
- tmpA = IRAM.read(IRAM.read(reg_indx));
+ tmpA = ind_read(IRAM.read(reg_indx));
  tmpA = tmpA ^ acc;
  IRAM.write(ACC, tmpA);
  return;
@@ -1866,6 +2581,7 @@ void ac_behavior(xrl_arr_R1)
  sc_uint<8> tmpA, acc, psw;
  int reg_indx;
 
+ psw = IRAM.read(PSW);
  if (psw.range(4, 3) == 0)
   reg_indx = 1;
  else if (psw.range(4, 3) == 1)
@@ -1875,7 +2591,7 @@ void ac_behavior(xrl_arr_R1)
  else
   reg_indx = 25;
  acc = IRAM.read(ACC);
- tmpA = IRAM.read(IRAM.read(reg_indx));
+ tmpA = ind_read(IRAM.read(reg_indx));
  tmpA = tmpA ^ acc;
  IRAM.write(ACC, tmpA);
  return;
@@ -1887,10 +2603,10 @@ void ac_behavior(anl_c_bit)
 
  psw = IRAM.read(PSW);
  temp = byte2;
- if (temp > 128)
-  aux = IRAM.read(temp.range(6, 3) * 8 + 128);
+ if (temp >= 128)
+  aux = direct_read(temp.range(6, 3) * 8 + 128);
  else
-  aux = IRAM.read(temp.range(6, 3) + 32);
+  aux = direct_read(temp.range(6, 3) + 32);
  psw[7] = psw[7] & aux[temp.range(2, 0)];
  IRAM.write(PSW, psw);
  return;
@@ -1903,10 +2619,10 @@ void ac_behavior(anl_c_nbit)
  psw = IRAM.read(PSW);
  temp = byte2;
 
- if (temp > 128)
-  aux = IRAM.read(temp.range(6, 3) * 8 + 128);
+ if (temp >= 128)
+  aux = direct_read(temp.range(6, 3) * 8 + 128);
  else
-  aux = IRAM.read(temp.range(6, 3) + 32);
+  aux = direct_read(temp.range(6, 3) + 32);
  unsigned idx = temp.range(2, 0);
  bool bit;
  //complement bit
@@ -1925,10 +2641,10 @@ void ac_behavior(orl_c_bit)
 
  psw = IRAM.read(PSW);
  temp = byte2;
- if (temp > 128)
-  aux = IRAM.read(temp.range(6, 3) * 8 + 128);
+ if (temp >= 128)
+  aux = direct_read(temp.range(6, 3) * 8 + 128);
  else
-  aux = IRAM.read(temp.range(6, 3) + 32);
+  aux = direct_read(temp.range(6, 3) + 32);
  psw[7] = psw[7] | aux[temp.range(2, 0)];
  IRAM.write(PSW, psw);
  return;
@@ -1940,10 +2656,10 @@ void ac_behavior(orl_c_nbit)
 
  psw = IRAM.read(PSW);
  temp = byte2;
- if (temp > 128)
-  aux = IRAM.read(temp.range(6, 3) * 8 + 128);
+ if (temp >= 128)
+  aux = direct_read(temp.range(6, 3) * 8 + 128);
  else
-  aux = IRAM.read(temp.range(6, 3) + 32);
+  aux = direct_read(temp.range(6, 3) + 32);
  psw[7] = psw[7] | !(aux[temp.range(2, 0)]);
  IRAM.write(PSW, psw);
  return;
@@ -2050,19 +2766,19 @@ void ac_behavior(cpl_bit)
  temp = byte2;
  if (temp < 128)
  {
-  aux = IRAM.read(temp.range(6, 3) + 32);
+  aux = latch_read(temp.range(6, 3) + 32);
   end = temp.range(6, 3) + 32;
  }
  else
  {
-  aux = IRAM.read(temp.range(6, 3) * 8 + 128);
+  aux = latch_read(temp.range(6, 3) * 8 + 128);
   end = temp.range(6, 3) * 8 + 128;
  }
  if (aux[temp.range(2, 0)] == 0)
   aux[temp.range(2, 0)] = 1;
  else
   aux[temp.range(2, 0)] = 0;
- IRAM.write(end, aux);
+ direct_write(end, aux);
  return;
 }
 
@@ -2097,26 +2813,18 @@ void ac_behavior(inc_dptr)
  dph = IRAM.read(DPTRH);
  temp.range(15, 8) = dph;
  temp.range(7, 0) = dpl;
- if (temp == 255)
- {
-  IRAM.write(DPTRL, 0);
-  IRAM.write(DPTRH, 0);
- }
- else
- {
-  temp = temp + 1;
-  IRAM.write(DPTRH, temp.range(15, 8));
-  IRAM.write(DPTRL, temp.range(7, 0));
- }
+ temp = temp + 1;
+ IRAM.write(DPTRH, temp.range(15, 8));
+ IRAM.write(DPTRL, temp.range(7, 0));
  return;
 }
 
 void ac_behavior(inc_iram)
 {
- if (IRAM.read(byte2) == 255)
-  IRAM.write(byte2, 0);
+ if (latch_read(byte2) == 255)
+  direct_write(byte2, 0);
  else
-  IRAM.write(byte2, IRAM.read(byte2) + 1);
+  direct_write(byte2, latch_read(byte2) + 1);
  return;
 }
 
@@ -2134,10 +2842,10 @@ void ac_behavior(inc_arr_R0)
   reg_indx = 16;
  else
   reg_indx = 24;
- if (IRAM.read(IRAM.read(reg_indx)) == 255)
-  IRAM.write(IRAM.read(reg_indx), 0);
+ if (ind_read(IRAM.read(reg_indx)) == 255)
+  ind_write(IRAM.read(reg_indx), 0);
  else
-  IRAM.write(IRAM.read(reg_indx), IRAM.read(IRAM.read(reg_indx)) + 1);
+  ind_write(IRAM.read(reg_indx), ind_read(IRAM.read(reg_indx)) + 1);
  return;
 }
 
@@ -2155,10 +2863,10 @@ void ac_behavior(inc_arr_R1)
   reg_indx = 17;
  else
   reg_indx = 25;
- if (IRAM.read(IRAM.read(reg_indx)) == 255)
-  IRAM.write(IRAM.read(reg_indx), 0);
+ if (ind_read(IRAM.read(reg_indx)) == 255)
+  ind_write(IRAM.read(reg_indx), 0);
  else
-  IRAM.write(IRAM.read(reg_indx), IRAM.read(IRAM.read(reg_indx)) + 1);
+  ind_write(IRAM.read(reg_indx), ind_read(IRAM.read(reg_indx)) + 1);
  return;
 }
 
@@ -2168,15 +2876,17 @@ void ac_behavior(ret)
  sc_uint<16> pc;
 
  index = IRAM.read(SP);
- msb = IRAM.read(index);
+ msb = ind_read(index);
  index--;
  IRAM.write(SP, index);
- lsb = IRAM.read(index);
+ lsb = ind_read(index);
  index--;
  IRAM.write(SP, index);
  pc.range(7, 0) = lsb;
  pc.range(15, 8) = msb;
  ac_pc = (unsigned int) pc;
+ if (stackchk != NULL)
+  i8051_stackcheck_ret(stackchk, index);
  return;
 }
 
@@ -2240,10 +2950,10 @@ void ac_behavior(rlc_a)
 
 void ac_behavior(dec_iram)
 {
- if (IRAM.read(byte2) == 0)
-  IRAM.write(byte2, 255);
+ if (latch_read(byte2) == 0)
+  direct_write(byte2, 255);
  else
-  IRAM.write(byte2, IRAM.read(byte2) - 1);
+  direct_write(byte2, latch_read(byte2) - 1);
  return;
 }
 
@@ -2272,11 +2982,11 @@ void ac_behavior(dec_arr_R0)
  else
   reg_indx = 24;
  idx = IRAM.read(reg_indx);
- value = IRAM.read(idx) - 1;
- if (IRAM.read(idx) == 0)
-  IRAM.write(idx, 255);
+ value = ind_read(idx) - 1;
+ if (ind_read(idx) == 0)
+  ind_write(idx, 255);
  else
-  IRAM.write(idx, value);
+  ind_write(idx, value);
  return;
 }
 
@@ -2294,10 +3004,10 @@ void ac_behavior(dec_arr_R1)
   reg_indx = 17;
  else
   reg_indx = 25;
- if (IRAM.read(IRAM.read(reg_indx)) == 0)
-  IRAM.write(IRAM.read(reg_indx), 255);
+ if (ind_read(IRAM.read(reg_indx)) == 0)
+  ind_write(IRAM.read(reg_indx), 255);
  else
-  IRAM.write(IRAM.read(reg_indx), IRAM.read(IRAM.read(reg_indx)) - 1);
+  ind_write(IRAM.read(reg_indx), ind_read(IRAM.read(reg_indx)) - 1);
  return;
 }
 
@@ -2341,20 +3051,18 @@ void ac_behavior(div)
  acc = IRAM.read(ACC);
  b = IRAM.read(B);
  psw = IRAM.read(PSW);
+ psw[7] = 0;
  if (b != 0)
  {
   result = acc / b;
   mod = acc % b;
-  psw[7] = 0;
+  psw[2] = 0;
   IRAM.write(ACC, result);
   IRAM.write(B, mod);
-  IRAM.write(PSW, psw);
  }
  else
- {
   psw[2] = 1;
-  IRAM.write(PSW, psw);
- }
+ IRAM.write(PSW, psw);
  return;
 }
 
@@ -2364,7 +3072,7 @@ void ac_behavior(movx_dptr_a)
 
  dptr = IRAM.read(DPTRL);
  dptr.range(15, 8) = IRAM.read(DPTRH);
- IRAMX.write(dptr, IRAM.read(ACC));
+ xdata_write(dptr, IRAM.read(ACC));
  return;
 }
 
@@ -2380,7 +3088,8 @@ void ac_behavior(movx_r0_a)
   reg_indx = 16;
  else
   reg_indx = 24;
- IRAMX.write(IRAM.read(reg_indx), IRAM.read(ACC));
+ // The P2 latch drives the high address byte.
+ xdata_write((IRAM.read(P2) << 8) | IRAM.read(reg_indx), IRAM.read(ACC));
  return;
 }
 
@@ -2396,7 +3105,8 @@ void ac_behavior(movx_r1_a)
   reg_indx = 17;
  else
   reg_indx = 25;
- IRAMX.write(IRAM.read(reg_indx), IRAM.read(ACC));
+ // The P2 latch drives the high address byte.
+ xdata_write((IRAM.read(P2) << 8) | IRAM.read(reg_indx), IRAM.read(ACC));
  return;
 }
 
@@ -2404,11 +3114,20 @@ void ac_behavior(reti)
 {
  sc_uint<16> pc;
 
- pc.range(15, 8) = IRAM.read(IRAM.read(SP));
+ // Leave the highest priority level in service.
+ if (irq_active & 2)
+  irq_active &= ~2;
+ else
+  irq_active &= ~1;
+ irq_check = true;
+ irq_hold = true;
+ pc.range(15, 8) = ind_read(IRAM.read(SP));
  IRAM.write(SP, (IRAM.read(SP) - 1));
- pc.range(7, 0) = IRAM.read(IRAM.read(SP));
+ pc.range(7, 0) = ind_read(IRAM.read(SP));
  IRAM.write(SP, (IRAM.read(SP) - 1));
  ac_pc = (unsigned int) pc;
+ if (stackchk != NULL)
+  i8051_stackcheck_ret(stackchk, IRAM.read(SP));
  return;
 }
 
@@ -2418,7 +3137,7 @@ void ac_behavior(movx_a_dptr)
 
  address.range(7, 0) = IRAM.read(DPTRL);
  address.range(15, 8) = IRAM.read(DPTRH);
- IRAM.write(ACC, IRAMX.read(address));
+ IRAM.write(ACC, xdata_read(address));
  return;
 }
 
@@ -2434,7 +3153,8 @@ void ac_behavior(movx_a_R0)
   reg_indx = 16;
  else
   reg_indx = 24;
- IRAM.write(ACC, IRAMX.read(IRAM.read(reg_indx)));
+ // The P2 latch drives the high address byte.
+ IRAM.write(ACC, xdata_read((IRAM.read(P2) << 8) | IRAM.read(reg_indx)));
  return;
 }
 
@@ -2450,25 +3170,26 @@ void ac_behavior(movx_a_R1)
   reg_indx = 17;
  else
   reg_indx = 25;
- IRAM.write(ACC, IRAMX.read(IRAM.read(reg_indx)));
+ // The P2 latch drives the high address byte.
+ IRAM.write(ACC, xdata_read((IRAM.read(P2) << 8) | IRAM.read(reg_indx)));
  return;
 }
 
 void ac_behavior(da)
 {
- sc_uint<9> sum;
- sc_uint<8> tempPSW = IRAM.read(PSW);
- sc_uint<8> tempACC = IRAM.read(ACC);
+ sc_uint<9> acc = IRAM.read(ACC);
+ sc_uint<8> psw = IRAM.read(PSW);
 
- if (tempPSW[6] || tempACC.range(3, 0) > 9)
- {
-  IRAM.write(ACC, IRAM.read(ACC) + 0x06);
-  sum = tempACC + 6;
-  tempPSW[7] = sum[8];
- }
- if (tempPSW[7] || tempACC.range(7, 4) > 9)
-  IRAM.write(ACC, IRAM.read(ACC) + 0x60);
- if (tempACC > 0x99)
-  IRAM.write(PSW, (IRAM.read(PSW) | 0x80));
+ // Both correction steps may set CY; DA never clears it.
+ if (psw[6] || acc.range(3, 0) > 9)
+  acc = acc + 0x06;
+ if (acc[8])
+  psw[7] = 1;
+ if (psw[7] || acc.range(7, 4) > 9)
+  acc = acc.range(7, 0) + 0x60;
+ if (acc[8])
+  psw[7] = 1;
+ IRAM.write(ACC, acc.range(7, 0));
+ IRAM.write(PSW, psw);
  return;
 }
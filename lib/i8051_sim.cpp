@@ -0,0 +1,244 @@
+/**
+ * @file      i8051_sim.cpp
+ * @author    The ArchC Team
+ *            http://www.archc.org/
+ *
+ *            Computer Systems Laboratory (LSC)
+ *            IC-UNICAMP
+ *            http://www.lsc.ic.unicamp.br/
+ *
+ * @version   1.0
+ * @date      Sat, 24 Oct 2026 14:12:05 -0300
+ *
+ * @brief     Embeddable i8051 simulator library on the reference core.
+ *
+ * @attention Copyright (C) 2002-2006 --- The ArchC Team
+ *
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <new>
+
+#include "i8051_sim.h"
+#include "i8051_core.H"
+#include "i8051_derivative.H"
+#include "i8051_loader.H"
+
+struct i8051_sim
+{
+ i8051_core core;
+};
+
+//! What stops a run at the current PC, or LIMIT for nothing.
+static inline i8051_sim_stop at(const i8051_core& c)
+{
+ unsigned op = c.code[c.pc];
+
+ if (op == 0x80 && c.code[(c.pc + 1) & 0xFFFF] == 0xFE)
+  return I8051_SIM_STOP_HALT;
+ if (op == 0xA5)
+  return I8051_SIM_STOP_RESERVED;
+ return I8051_SIM_STOP_LIMIT;
+}
+
+//! Where [addr, addr + len) of a space is, or NULL if out of bounds.
+static unsigned char* locate(const i8051_sim* s, enum i8051_sim_space space,
+                             unsigned addr, size_t len)
+{
+ i8051_core& c = const_cast<i8051_core&>(s->core);
+ unsigned lo = 0, hi = 0;
+ unsigned char* p = NULL;
+
+ switch (space)
+ {
+  case I8051_SIM_CODE: p = c.code; hi = 0x10000; break;
+  case I8051_SIM_XDATA: p = c.xdata; hi = 0x10000; break;
+  case I8051_SIM_DIRECT: p = c.iram; hi = 0x100; break;
+  case I8051_SIM_IDATA:
+   if (c.is8052)
+   {
+    p = c.idata;
+    lo = 0x80;
+    hi = 0x100;
+   }
+   break;
+  case I8051_SIM_PINS: p = c.input; hi = 4; break;
+ }
+ if (p == NULL || addr < lo || addr > hi || len > hi - addr)
+ {
+  fprintf(stderr, "i8051: bad access %x+%zx to space %d\n", addr, len,
+          (int) space);
+  return NULL;
+ }
+ return p + addr;
+}
+
+extern "C" {
+
+i8051_sim* i8051_sim_create(unsigned flags)
+{
+ i8051_sim* s;
+
+ if ((flags & I8051_SIM_DALLAS) && (flags & I8051_SIM_1CLK))
+ {
+  fprintf(stderr, "i8051: more than one derivative in flags %x\n", flags);
+  return NULL;
+ }
+ if ((s = new (std::nothrow) i8051_sim) == NULL)
+  return NULL;
+ s->core.is8052 = flags & (I8051_SIM_8052 | I8051_SIM_DALLAS | I8051_SIM_1CLK);
+ s->core.dual_dptr = flags & (I8051_SIM_DUAL_DPTR | I8051_SIM_DALLAS);
+ if (flags & I8051_SIM_DALLAS)
+ {
+  s->core.op_cycles = i8051_cycles_dallas;
+  s->core.irq_cycles = i8051_dallas::irq_cycles;
+ }
+ else if (flags & I8051_SIM_1CLK)
+ {
+  s->core.op_cycles = i8051_cycles_1clk;
+  s->core.irq_cycles = i8051_1clk::irq_cycles;
+ }
+ return s;
+}
+
+void i8051_sim_destroy(i8051_sim* s)
+{
+ delete s;
+}
+
+void i8051_sim_reset(i8051_sim* s)
+{
+ s->core.reset();
+}
+
+int i8051_sim_load(i8051_sim* s, const char* file)
+{
+ i8051_image img;
+
+ memset(&img, 0, sizeof(img));
+ img.code = s->core.code;
+ img.xdata = s->core.xdata;
+ if (!i8051_load(file, &img))
+  return -1;
+ s->core.pc = img.entry;
+ return 0;
+}
+
+int i8051_sim_read(const i8051_sim* s, enum i8051_sim_space space,
+                   unsigned addr, void* buf, size_t len)
+{
+ const unsigned char* p = locate(s, space, addr, len);
+
+ if (p == NULL)
+  return -1;
+ memcpy(buf, p, len);
+ return 0;
+}
+
+int i8051_sim_write(i8051_sim* s, enum i8051_sim_space space,
+                    unsigned addr, const void* buf, size_t len)
+{
+ unsigned char* p = locate(s, space, addr, len);
+
+ if (p == NULL)
+  return -1;
+ memcpy(p, buf, len);
+ return 0;
+}
+
+void i8051_sim_get_regs(const i8051_sim* s, struct i8051_sim_regs* r)
+{
+ const i8051_core& c = s->core;
+ unsigned bank = c.iram[I8051_PSW] & 0x18;
+
+ r->pc = c.pc;
+ r->a = c.iram[I8051_ACC];
+ r->b = c.iram[I8051_B];
+ r->psw = c.iram[I8051_PSW];
+ r->sp = c.iram[I8051_SP];
+ r->dptr = c.dptr();
+ memcpy(r->r, c.iram + bank, 8);
+}
+
+void i8051_sim_set_regs(i8051_sim* s, const struct i8051_sim_regs* r)
+{
+ i8051_core& c = s->core;
+ unsigned d = c.dual_dptr ? (c.iram[I8051_DPS] & 1) << 1 : 0;
+
+ c.pc = r->pc & 0xFFFF;
+ c.iram[I8051_ACC] = r->a;
+ c.iram[I8051_B] = r->b;
+ c.iram[I8051_PSW] = (r->psw & ~I8051_P) | i8051_parity(r->a);
+ c.iram[I8051_SP] = r->sp;
+ c.iram[I8051_DPL + d] = r->dptr & 0xFF;
+ c.iram[I8051_DPH + d] = (r->dptr >> 8) & 0xFF;
+ memcpy(c.iram + (c.iram[I8051_PSW] & 0x18), r->r, 8);
+}
+
+unsigned long long i8051_sim_cycles(const i8051_sim* s)
+{
+ return s->core.cycles;
+}
+
+unsigned long long i8051_sim_instrs(const i8051_sim* s)
+{
+ return s->core.instrs;
+}
+
+enum i8051_sim_stop i8051_sim_run_for(i8051_sim* s, unsigned long long n,
+                                      enum i8051_sim_unit unit)
+{
+ i8051_core& c = s->core;
+ const unsigned long long& count = unit == I8051_SIM_CYCLES ? c.cycles
+                                                            : c.instrs;
+ unsigned long long end = count + n;
+ i8051_sim_stop why;
+
+ while (count < end)
+ {
+  if ((why = at(c)) != I8051_SIM_STOP_LIMIT)
+   return why;
+  c.step();
+ }
+ return I8051_SIM_STOP_LIMIT;
+}
+
+enum i8051_sim_stop i8051_sim_run_until_pc(i8051_sim* s, unsigned pc,
+                                           unsigned long long limit)
+{
+ i8051_core& c = s->core;
+ unsigned long long n;
+ i8051_sim_stop why;
+
+ for (n = 0; n < limit; n++)
+ {
+  if (c.pc == pc)
+   return I8051_SIM_STOP_PC;
+  if ((why = at(c)) != I8051_SIM_STOP_LIMIT)
+   return why;
+  c.step();
+ }
+ return c.pc == pc ? I8051_SIM_STOP_PC : I8051_SIM_STOP_LIMIT;
+}
+
+enum i8051_sim_stop i8051_sim_run_until(i8051_sim* s,
+                                        int (*cond)(i8051_sim*, void*),
+                                        void* arg, unsigned long long limit)
+{
+ i8051_core& c = s->core;
+ unsigned long long n;
+ i8051_sim_stop why;
+
+ for (n = 0; n < limit; n++)
+ {
+  if (cond(s, arg))
+   return I8051_SIM_STOP_COND;
+  if ((why = at(c)) != I8051_SIM_STOP_LIMIT)
+   return why;
+  c.step();
+ }
+ return cond(s, arg) ? I8051_SIM_STOP_COND : I8051_SIM_STOP_LIMIT;
+}
+
+}
@@ -0,0 +1,130 @@
+/**
+ * @file      i8051_sim.h
+ * @author    The ArchC Team
+ *            http://www.archc.org/
+ *
+ *            Computer Systems Laboratory (LSC)
+ *            IC-UNICAMP
+ *            http://www.lsc.ic.unicamp.br/
+ *
+ * @version   1.0
+ * @date      Sat, 24 Oct 2026 14:12:05 -0300
+ *
+ * @brief     Embeddable i8051 simulator library (C API).
+ *
+ * An instance is a reference core (i8051_core.H): no SystemC, no
+ * elaboration, no global state, so creating one costs a few
+ * microseconds and instances can live in different threads. It runs
+ * the instruction set with the model's cycle counts; there are no
+ * interrupts or peripherals, and ports read the levels set with
+ * I8051_SIM_PINS. Cycles follow the classic table unless a derivative
+ * flag (I8051_SIM_DALLAS, I8051_SIM_1CLK) selects another one, as
+ * -DI8051_DERIVATIVE does for the model (i8051_derivative.H).
+ *
+ *     g++ -O2 -fPIC -shared -I.. -o libi8051sim.so i8051_sim.cpp
+ *
+ *     i8051_sim* s = i8051_sim_create(0);
+ *     if (i8051_sim_load(s, "test.hex") != 0) ...
+ *     switch (i8051_sim_run_until_pc(s, 0x0123, 1000000)) ...
+ *     i8051_sim_read(s, I8051_SIM_XDATA, 0x8000, buf, 16);
+ *     i8051_sim_destroy(s);
+ *
+ * Functions that can fail return 0 on success and -1 on error.
+ *
+ * @attention Copyright (C) 2002-2006 --- The ArchC Team
+ *
+ */
+
+#ifndef _I8051_SIM_H
+#define _I8051_SIM_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct i8051_sim i8051_sim;
+
+/* i8051_sim_create() flags */
+#define I8051_SIM_8052      0x01    /* upper 128 bytes of indirect RAM */
+#define I8051_SIM_DUAL_DPTR 0x02    /* DPS selects DPL1/DPH1 */
+#define I8051_SIM_DALLAS    0x04    /* 8052, dual DPTR, Dallas cycles */
+#define I8051_SIM_1CLK      0x08    /* 8052, single clock core cycles */
+
+/* Memory spaces */
+enum i8051_sim_space
+{
+ I8051_SIM_CODE,                   /* 64K */
+ I8051_SIM_XDATA,                  /* 64K */
+ I8051_SIM_DIRECT,                 /* 0x00-0x7F RAM, 0x80-0xFF SFRs */
+ I8051_SIM_IDATA,                  /* 0x80-0xFF upper RAM (8052) */
+ I8051_SIM_PINS                    /* 4: levels driven on P0-P3 */
+};
+
+/* Units of i8051_sim_run_for() */
+enum i8051_sim_unit
+{
+ I8051_SIM_INSTRS,
+ I8051_SIM_CYCLES
+};
+
+/* Why a run stopped */
+enum i8051_sim_stop
+{
+ I8051_SIM_STOP_LIMIT,             /* ran the requested amount */
+ I8051_SIM_STOP_PC,                /* reached the target PC */
+ I8051_SIM_STOP_COND,              /* the condition returned nonzero */
+ I8051_SIM_STOP_HALT,              /* at "sjmp $" */
+ I8051_SIM_STOP_RESERVED           /* at the reserved opcode 0xA5 */
+};
+
+/* Register file; r[] is the bank selected by PSW. */
+struct i8051_sim_regs
+{
+ unsigned pc;
+ unsigned char a, b, psw, sp;
+ unsigned dptr;
+ unsigned char r[8];
+};
+
+/* NULL on failure, or with both I8051_SIM_DALLAS and I8051_SIM_1CLK. */
+i8051_sim* i8051_sim_create(unsigned flags);
+void i8051_sim_destroy(i8051_sim* s);
+
+/* Power-on state of RAM, SFRs and counters; code and XDATA are kept. */
+void i8051_sim_reset(i8051_sim* s);
+
+/* Intel HEX, raw binary or ELF, into code (and XDATA); sets the PC. */
+int i8051_sim_load(i8051_sim* s, const char* file);
+
+int i8051_sim_read(const i8051_sim* s, enum i8051_sim_space space,
+                   unsigned addr, void* buf, size_t len);
+int i8051_sim_write(i8051_sim* s, enum i8051_sim_space space,
+                    unsigned addr, const void* buf, size_t len);
+
+void i8051_sim_get_regs(const i8051_sim* s, struct i8051_sim_regs* r);
+void i8051_sim_set_regs(i8051_sim* s, const struct i8051_sim_regs* r);
+
+unsigned long long i8051_sim_cycles(const i8051_sim* s);
+unsigned long long i8051_sim_instrs(const i8051_sim* s);
+
+/* Run n instructions or cycles (the last instruction may end past n). */
+enum i8051_sim_stop i8051_sim_run_for(i8051_sim* s, unsigned long long n,
+                                      enum i8051_sim_unit unit);
+
+/* Run until the PC is pc, at most limit instructions. */
+enum i8051_sim_stop i8051_sim_run_until_pc(i8051_sim* s, unsigned pc,
+                                           unsigned long long limit);
+
+/* Run until cond(s, arg), checked before every instruction, returns
+   nonzero, at most limit instructions. */
+enum i8051_sim_stop i8051_sim_run_until(i8051_sim* s,
+                                        int (*cond)(i8051_sim*, void*),
+                                        void* arg, unsigned long long limit);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
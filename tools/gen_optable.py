@@ -0,0 +1,220 @@
+#!/usr/bin/env python3
+#
+# Generate i8051_optable.H, the 256-entry opcode table, from the ISA
+# description in i8051_isa.ac (formats, decoders and set_asm syntax),
+# with the SFR and SFR bit names of its "sfr" asm map.
+#
+#     python3 tools/gen_optable.py [i8051_isa.ac] > i8051_optable.H
+#
+# Copyright (C) 2002-2006 --- The ArchC Team
+#
+
+import os
+import re
+import sys
+
+KINDS = {
+    "A": "I8051_OPD_A", "C": "I8051_OPD_C", "AB": "I8051_OPD_AB",
+    "DPTR": "I8051_OPD_DPTR", "@R0": "I8051_OPD_IND", "@R1": "I8051_OPD_IND",
+    "@A+DPTR": "I8051_OPD_CODE_DPTR", "@A+PC": "I8051_OPD_CODE_PC",
+    "@DPTR": "I8051_OPD_XDPTR",
+}
+BIT_MNEMONICS = ("clr", "setb", "cpl", "jb", "jnb", "jbc")
+
+
+def fields_of(fmt):
+    """Map field name to (first bit, width), bit 0 being the MSB of byte 0."""
+    pos, out = 0, {}
+    for name, width in re.findall(r"%(\w+):(\d+)", fmt):
+        out[name] = (pos, int(width))
+        pos += int(width)
+    return out, pos // 8
+
+
+def operand(text, fields, layout, mnemonic, other):
+    """Kind and operand byte of one set_asm operand."""
+    text = text.strip()
+    if text in KINDS:
+        return KINDS[text], 0
+    field = fields.pop(0) if "%" in text else None
+    # "page+addr0" (ADDR11) keeps the low byte in addr0; "byte2+byte3"
+    # starts at byte2.
+    part = field.split("+")[-1 if field and field.startswith("page") else 0] \
+        if field else None
+    byte = layout[part][0] // 8 if field else 0
+    if text.startswith("#"):
+        return ("I8051_OPD_IMM16" if "+" in field else "I8051_OPD_IMM"), byte
+    if text.startswith("/"):
+        return "I8051_OPD_NBIT", byte
+    if text == "%reg":
+        return "I8051_OPD_REG", 0
+    if text.startswith("%addr(pcrel"):
+        return "I8051_OPD_REL", byte
+    if text == "%addr":
+        return ("I8051_OPD_ADDR11" if field.startswith("page")
+                else "I8051_OPD_ADDR16"), byte
+    if mnemonic in BIT_MNEMONICS or other == "C":
+        return "I8051_OPD_BIT", byte
+    return "I8051_OPD_DIR", byte
+
+
+def isa_path(src):
+    return src or os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                               "..", "i8051_isa.ac")
+
+
+def load_sfr(src=None):
+    """Names of the SFRs (0x80-0xFF) and of the bit addresses from the
+    "sfr" asm map: the "_" names before the "bit addressable" comment are
+    registers, the rest bits, single names winning over "_X."[n] ranges."""
+    isa = open(isa_path(src)).read()
+    body = re.search(r"ac_asm_map\s+sfr\s*{(.*?)\n\s*}", isa, re.S).group(1)
+    regs, bits = body.split("bit addressable")
+    sfr, bit = {}, {}
+    for m in re.finditer(r'"(_\w+)"\s*=\s*(\w+)\s*;', regs):
+        sfr.setdefault(int(m.group(2), 0), m.group(1))
+    for m in re.finditer(r'"(_\w+)"\s*=\s*(\w+)\s*;', bits):
+        bit.setdefault(int(m.group(2), 0), m.group(1))
+    for m in re.finditer(r'"(_\w+\.)"\[(\d+)\.\.(\d+)\]\s*=\s*'
+                         r'\[(\w+)\.\.\w+\]', bits):
+        for n in range(int(m.group(2)), int(m.group(3)) + 1):
+            bit.setdefault(int(m.group(4), 0) + n, m.group(1) + str(n))
+    return sfr, bit
+
+
+def load(src=None):
+    """Decode i8051_isa.ac into 256 entries of (name, mnemonic, syntax,
+    size, operands), None for undefined opcodes."""
+    isa = open(isa_path(src)).read()
+    formats = {n: fields_of(f) for n, f in
+               re.findall(r'ac_format\s+(\w+)\s*=\s*"([^"]*)"', isa)}
+    fmt_of = {}
+    for m in re.finditer(r"ac_instr<(\w+)>\s*([^;]*);", isa):
+        for name in m.group(2).split(","):
+            fmt_of[name.strip()] = m.group(1)
+    asm = {}
+    for name, syntax, args in re.findall(
+            r'(\w+)\.set_asm\("([^"]*)"\s*(?:,([^)]*))?\)', isa):
+        # Keep the first plain form; "#hi(...)" variants are for the assembler.
+        if "hi(" not in syntax and name not in asm:
+            asm[name] = (syntax, [a.strip() for a in args.split(",") if a.strip()])
+    table = [None] * 256
+    for name, dec in re.findall(r"(\w+)\.set_decoder\(([^)]*)\)", isa):
+        layout, size = formats[fmt_of[name]]
+        want = [(f.strip(), int(v, 0)) for f, v in
+                (d.split("=") for d in dec.split(","))]
+        syntax, args = asm[name]
+        for op in range(256):
+            if all((op >> (8 - layout[f][0] - layout[f][1]))
+                   & ((1 << layout[f][1]) - 1) == v for f, v in want):
+                if table[op] is not None:
+                    sys.exit("gen_optable: opcode %02x decodes as %s and %s"
+                             % (op, table[op][0], name))
+                mnemonic, _, rest = syntax.partition(" ")
+                texts = [t for t in re.split(r",(?![^(]*\))", rest)
+                         if t.strip()]
+                fields = list(args)
+                opds = []
+                for i, t in enumerate(texts):
+                    other = texts[1 - i].strip() if len(texts) == 2 else ""
+                    opds.append(operand(t, fields, layout, mnemonic, other))
+                table[op] = (name, mnemonic, syntax, size, opds)
+    return table
+
+
+def main():
+    src = sys.argv[1] if len(sys.argv) > 1 else None
+    table = load(src)
+    sfr, bit = load_sfr(src)
+    out = sys.stdout
+    out.write("""/**
+ * @file      i8051_optable.H
+ * @author    The ArchC Team
+ *            http://www.archc.org/
+ *
+ *            Computer Systems Laboratory (LSC)
+ *            IC-UNICAMP
+ *            http://www.lsc.ic.unicamp.br/
+ *
+ * @version   1.0
+ *
+ * @brief     Opcode table generated from i8051_isa.ac.
+ *
+ * Generated by tools/gen_optable.py; do not edit. One entry per opcode
+ * with the instruction name, its assembly syntax, length and operands in
+ * assembly order. Operand bytes index the instruction (1 or 2); Rn and
+ * @Ri take the register from the opcode. The SFR and bit names are the
+ * ones of the sfr asm map for 0x80-0xFF, NULL where it has none.
+ *
+ * @attention Copyright (C) 2002-2006 --- The ArchC Team
+ *
+ */
+
+#ifndef _I8051_OPTABLE_H
+#define _I8051_OPTABLE_H
+
+enum i8051_opd_kind
+{
+ I8051_OPD_NONE,
+ I8051_OPD_A,
+ I8051_OPD_C,
+ I8051_OPD_AB,
+ I8051_OPD_DPTR,
+ I8051_OPD_REG,                 // Rn, n = opcode & 7
+ I8051_OPD_IND,                 // @Ri, i = opcode & 1
+ I8051_OPD_DIR,                 // direct address
+ I8051_OPD_BIT,                 // bit address
+ I8051_OPD_NBIT,                // complemented bit address
+ I8051_OPD_IMM,                 // #data
+ I8051_OPD_IMM16,               // #data16
+ I8051_OPD_REL,                 // relative jump target
+ I8051_OPD_ADDR11,              // same 2K page jump target
+ I8051_OPD_ADDR16,              // absolute jump target
+ I8051_OPD_CODE_DPTR,           // @A+DPTR
+ I8051_OPD_CODE_PC,             // @A+PC
+ I8051_OPD_XDPTR                // @DPTR
+};
+
+struct i8051_operand
+{
+ unsigned char kind;
+ unsigned char byte;
+};
+
+struct i8051_opinfo
+{
+ const char* name;              // ac_instr name, NULL if undefined
+ const char* mnemonic;
+ const char* syntax;            // first set_asm form
+ unsigned char length;
+ unsigned char nopd;
+ i8051_operand opd[3];
+};
+
+static const i8051_opinfo i8051_optable[256] = {
+""")
+    for op in range(256):
+        e = table[op]
+        if e is None:
+            out.write(" /* %02X */ { NULL, NULL, NULL, 1, 0, "
+                      "{ { I8051_OPD_NONE, 0 } } },\n" % op)
+            continue
+        name, mnemonic, syntax, size, opds = e
+        ol = ", ".join("{ %s, %d }" % o for o in opds) or "{ I8051_OPD_NONE, 0 }"
+        out.write(' /* %02X */ { "%s", "%s", "%s", %d, %d, { %s } },\n'
+                  % (op, name, mnemonic, syntax, size, len(opds), ol))
+    out.write("};\n")
+    for var, names, base in (("i8051_sfr_name[128]", sfr, 0x80),
+                             ("i8051_bit_name[128]", bit, 0x80)):
+        out.write("\nstatic const char* const %s = {\n" % var)
+        for row in range(base, 256, 8):
+            out.write(" " + " ".join(
+                ('"%s",' % names[a]) if a in names else "NULL,"
+                for a in range(row, row + 8)).rstrip(",") +
+                (",\n" if row < 248 else "\n"))
+        out.write("};\n")
+    out.write("\n#endif\n")
+
+
+if __name__ == "__main__":
+    main()
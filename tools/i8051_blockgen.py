@@ -0,0 +1,742 @@
+#!/usr/bin/env python3
+#
+# Block compiler: translate a fixed i8051 program image into C++, one
+# straight-line piece of code per basic block, for a compiled simulator
+# in the spirit of ArchC's accsim.
+#
+#     python3 tools/i8051_blockgen.py [options] image > prog.cpp
+#     g++ -O2 -I.. -I. -DI8051_BLOCK_MAIN -o prog prog.cpp
+#     ./prog [-c] [-n limit] image
+#
+# The code reachable from the reset vector, the interrupt vectors and
+# any -e entry is split into basic blocks. Within a block
+#
+#  - register bank addresses are constants when no instruction in the
+#    image writes PSW.RS (otherwise the bank is read once per block);
+#  - CY, AC, OV and P are only computed when something reads them before
+#    the block overwrites them; every flag is live at block exits;
+#  - DPTR lives in a local and is written back at the block exits;
+#  - port, SFR and bit addresses are resolved at generation time.
+#
+# Blocks chain to each other with goto; returns and jmp @A+DPTR go
+# through a switch on the pc, and code that was not found statically is
+# run by the reference core (i8051_core.H). The generated simulator is
+# bit-exact with i8051_core, cycle counts included.
+#
+# Copyright (C) 2002-2006 --- The ArchC Team
+#
+
+import argparse
+import os
+import re
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import gen_optable
+
+ROOT = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..")
+
+CY, AC, OV, P = 0x80, 0x40, 0x04, 0x01
+ALL = CY | AC | OV | P
+PSW, ACC, B, SP, DPL, DPH, P2 = 0xD0, 0xE0, 0xF0, 0x81, 0x82, 0x83, 0xA0
+VECTORS = (0x03, 0x0B, 0x13, 0x1B, 0x23, 0x2B)
+CONDITIONAL = ("jc", "jnc", "jz", "jnz", "jb", "jnb", "jbc", "cjne", "djnz")
+STACK = ("push", "pop", "acall", "lcall", "ret", "reti")
+A_WRITERS = ("add", "addc", "subb", "da", "mul", "div", "rl", "rlc", "rr",
+             "rrc", "swap", "xch", "xchd", "movc")
+
+
+def load_image(fn):
+    """Code bytes of an Intel HEX or raw binary image, and which are set."""
+    code, used = bytearray(0x10000), bytearray(0x10000)
+    data = open(fn, "rb").read()
+    if not data.startswith(b":"):
+        code[:len(data)] = data[:0x10000]
+        used[:len(data)] = b"\1" * min(len(data), 0x10000)
+        return code, used
+    base = 0
+    for line in data.decode("ascii", "replace").splitlines():
+        line = line.strip()
+        if not line.startswith(":"):
+            continue
+        rec = bytes.fromhex(line[1:])
+        n, addr, kind = rec[0], rec[1] << 8 | rec[2], rec[3]
+        if kind == 0:
+            for i in range(n):
+                a = (base + addr + i) & 0xFFFF
+                code[a] = rec[4 + i]
+                used[a] = 1
+        elif kind == 1:
+            break
+        elif kind in (2, 4):
+            base = (rec[4] << 8 | rec[5]) << (4 if kind == 2 else 16)
+    return code, used
+
+
+def load_cycles():
+    src = open(os.path.join(ROOT, "i8051_cycles.H")).read()
+    body = src[src.index("{") + 1:src.index("}")]
+    body = re.sub(r"/\*.*?\*/", "", body)
+    return [int(v) for v in body.replace(",", " ").split()]
+
+
+class Insn:
+    def __init__(self, table, code, addr):
+        self.addr = addr
+        self.op = code[addr]
+        e = table[self.op]
+        self.size = e[3] if e else 1
+        self.b = [code[(addr + i) & 0xFFFF] for i in range(self.size)]
+        self.next = (addr + self.size) & 0xFFFF
+        self.name = e[0] if e else None
+        self.mnemonic = e[1] if e else "reserved"
+        self.syntax = e[2] if e else "reserved"
+        self.opds = [(k[len("I8051_OPD_"):], byte) for k, byte in e[4]] \
+            if e else []
+        self.target = None
+        for kind, byte in self.opds:
+            if kind == "REL":
+                rel = self.b[byte]
+                self.target = (self.next + rel - (rel & 0x80) * 2) & 0xFFFF
+            elif kind == "ADDR11":
+                self.target = (self.next & 0xF800) | ((self.op & 0xE0) << 3) \
+                    | self.b[byte]
+            elif kind == "ADDR16":
+                self.target = self.b[byte] << 8 | self.b[byte + 1]
+        m = self.mnemonic
+        self.ends = self.target is not None or m in ("ret", "reti", "jmp")
+        self.halt = m == "sjmp" and self.target == addr
+
+    def val(self, n):
+        kind, byte = self.opds[n]
+        return self.b[byte]
+
+    def kinds(self):
+        return [k for k, _ in self.opds]
+
+    def dirs(self):
+        """Direct and bit operands as (kind, address) pairs."""
+        return [(k, self.b[byte]) for k, byte in self.opds
+                if k in ("DIR", "BIT", "NBIT")]
+
+    def text(self):
+        names = {"REG": "R%d" % (self.op & 7), "IND": "@R%d" % (self.op & 1),
+                 "CODE_DPTR": "@A+DPTR", "CODE_PC": "@A+PC",
+                 "XDPTR": "@DPTR"}
+        opds = []
+        for kind, byte in self.opds:
+            v = self.b[byte]
+            if kind in names:
+                opds.append(names[kind])
+            elif kind in ("REL", "ADDR11", "ADDR16"):
+                opds.append("0x%04X" % self.target)
+            elif kind == "IMM16":
+                opds.append("#0x%04X" % (v << 8 | self.b[byte + 1]))
+            elif kind == "IMM":
+                opds.append("#0x%02X" % v)
+            elif kind in ("DIR", "BIT", "NBIT"):
+                opds.append(("/" if kind == "NBIT" else "") + "0x%02X" % v)
+            else:
+                opds.append(kind)
+        return "%04X  %-9s %s %s" % (self.addr,
+                                     " ".join("%02X" % x for x in self.b),
+                                     self.mnemonic, ",".join(opds))
+
+
+def bit_byte(bit):
+    return 0x20 + (bit >> 3) if bit < 0x80 else bit & 0xF8
+
+
+def writes_psw_rs(i):
+    """Whether i may change PSW.RS through its direct or bit operands."""
+    m = i.mnemonic
+    if m in ("clr", "setb", "cpl", "jbc") or (m == "mov" and
+                                              i.kinds()[:1] == ["BIT"]):
+        return any(k == "BIT" and a in (0xD3, 0xD4) for k, a in i.dirs())
+    if m in ("mov", "anl", "orl", "xrl", "inc", "dec", "djnz", "pop"):
+        return i.kinds()[0] == "DIR" and i.val(0) == PSW
+    if m == "xch":
+        return i.kinds()[1] == "DIR" and i.val(1) == PSW
+    return False
+
+
+def flags(i, is8052):
+    """Flags read and flags fully overwritten by i (P: A or PSW changed)."""
+    m, kinds = i.mnemonic, i.kinds()
+    rd = wr = 0
+    for k, a in i.dirs():
+        if (k == "DIR" and a == PSW) or (k != "DIR" and bit_byte(a) == PSW):
+            rd |= ALL
+    if not is8052 and ("IND" in kinds or m in STACK):
+        rd |= ALL                   # @Ri and the stack may reach the SFRs
+    if m in ("add", "addc", "subb"):
+        wr |= CY | AC | OV
+        if m != "add":
+            rd |= CY
+    elif m in ("mul", "div"):
+        wr |= CY | OV
+    elif m == "da":
+        rd |= CY | AC
+    elif m in ("rlc", "rrc"):
+        rd |= CY
+        wr |= CY
+    elif m == "cjne":
+        wr |= CY
+    elif m in ("clr", "setb") and kinds == ["C"]:
+        wr |= CY
+    elif m == "mov" and kinds[0] == "C":
+        wr |= CY
+    elif m in ("cpl", "anl", "orl") and kinds[0] == "C":
+        rd |= CY
+    elif (m == "mov" and kinds[1:] == ["C"]) or m in ("jc", "jnc"):
+        rd |= CY
+    dst = kinds[0] if kinds else None
+    if m in A_WRITERS or (dst == "A" and m not in ("cjne", "jmp")) or \
+            (dst == "DIR" and i.val(0) in (ACC, PSW) and m not in
+             ("push", "cjne")) or \
+            (m == "xch" and kinds[1] == "DIR" and i.val(1) in (ACC, PSW)) or \
+            (dst == "BIT" and m != "jb" and m != "jnb" and
+             bit_byte(i.val(0)) in (ACC, PSW)):
+        wr |= P
+    return rd, wr
+
+
+class Program:
+    def __init__(self, code, used, entries, is8052):
+        self.table = gen_optable.load()
+        self.cycles = load_cycles()
+        self.code, self.used, self.is8052 = code, used, is8052
+        self.insns, self.leaders, self.halts = {}, set(), set()
+        self.walk([a for a in entries if used[a]])
+        # Vectors that fall inside code reached from the entries are not
+        # interrupt handlers.
+        covered = set(a + k for a, i in self.insns.items()
+                      for k in range(i.size))
+        self.walk([a for a in VECTORS if used[a] and a not in covered])
+        self.leaders -= self.halts
+        self.fold = not any(writes_psw_rs(i) for i in self.insns.values())
+
+    def walk(self, work):
+        code, used = self.code, self.used
+        self.leaders.update(work)
+        while work:
+            a = work.pop()
+            while used[a] and a not in self.insns:
+                i = Insn(self.table, code, a)
+                self.insns[a] = i
+                if i.halt:
+                    self.halts.add(a)
+                    break
+                if i.target is not None and used[i.target]:
+                    if i.target not in self.leaders:
+                        self.leaders.add(i.target)
+                        work.append(i.target)
+                if i.ends:
+                    if i.mnemonic in CONDITIONAL + ("acall", "lcall"):
+                        if i.next not in self.leaders:
+                            self.leaders.add(i.next)
+                            work.append(i.next)
+                    break
+                a = i.next
+
+    def block(self, a):
+        out = []
+        while True:
+            i = self.insns[a]
+            out.append(i)
+            if i.ends or i.next in self.leaders or i.next in self.halts \
+                    or i.next not in self.insns:
+                return out
+            a = i.next
+
+
+class Block:
+    """Code for one basic block."""
+
+    def __init__(self, prog, insns):
+        self.p, self.insns = prog, insns
+        self.fold = prog.fold
+        self.classic = not prog.is8052
+        kinds = [k for i in insns for k in i.kinds()]
+        dirs = [a for i in insns for k, a in i.dirs() if k == "DIR"]
+        self.local_dptr = any(k in ("DPTR", "XDPTR", "CODE_DPTR")
+                              for k in kinds) or DPL in dirs or DPH in dirs
+        self.local_bank = not self.fold and any(
+            k in ("REG", "IND") for k in kinds)
+        self.lines = []
+        self.n = self.cyc = 0
+
+    # Operands
+
+    def reg(self, n):
+        if self.fold:
+            return "c.iram[0x%02X]" % n
+        return "c.iram[bank | %d]" % n
+
+    def ind(self, a):
+        if self.classic:
+            return "c.iram[%s]" % a
+        return "(*(%s & 0x80 ? &c.idata[%s] : &c.iram[%s]))" % (a, a, a)
+
+    def rd(self, a, latch=False):
+        """Direct read; ports give their pins unless latch is set."""
+        if self.local_dptr and a == DPL:
+            return "(dptr & 0xFF)"
+        if self.local_dptr and a == DPH:
+            return "(dptr >> 8)"
+        if not latch and (a & 0xCF) == 0x80:
+            return "(c.iram[0x%02X] & c.input[%d])" % (a, (a >> 4) & 3)
+        return "c.iram[0x%02X]" % a
+
+    def wr(self, a, v):
+        if self.local_dptr and a == DPL:
+            return ["dptr = (dptr & 0xFF00) | (unsigned char) (%s);" % v]
+        if self.local_dptr and a == DPH:
+            return ["dptr = (dptr & 0x00FF) | (unsigned char) (%s) << 8;" % v]
+        out = ["c.iram[0x%02X] = %s;" % (a, v)]
+        if a == PSW and self.local_bank:
+            out.append("bank = c.iram[0xD0] & 0x18;")
+        return out
+
+    def src(self, i, n):
+        kind, byte = i.opds[n]
+        v = i.b[byte]
+        if kind == "A":
+            return "c.iram[0xE0]"
+        if kind == "REG":
+            return self.reg(i.op & 7)
+        if kind == "IND":
+            return self.ind("ia")
+        if kind == "DIR":
+            return self.rd(v)
+        if kind == "IMM":
+            return "0x%02X" % v
+        if kind == "C":
+            return "(c.iram[0xD0] >> 7)"
+        if kind in ("BIT", "NBIT"):
+            e = "(%s >> %d & 1)" % (self.rd(bit_byte(v)), v & 7)
+            return e if kind == "BIT" else "!" + e
+        raise ValueError(kind)
+
+    def put(self, i, n, v):
+        kind, byte = i.opds[n]
+        if kind == "A":
+            return ["c.iram[0xE0] = %s;" % v]
+        if kind == "REG":
+            return ["%s = %s;" % (self.reg(i.op & 7), v)]
+        if kind == "IND":
+            return ["%s = %s;" % (self.ind("ia"), v)]
+        if kind == "DIR":
+            return self.wr(i.b[byte], v)
+        raise ValueError(kind)
+
+    def modify(self, i, n, f):
+        """Read-modify-write of operand n (latches, not pins)."""
+        kind, byte = i.opds[n]
+        if kind == "DIR":
+            a = i.b[byte]
+            return self.wr(a, f(self.rd(a, True)))
+        return self.put(i, n, f(self.src(i, n)))
+
+    def set_bit(self, bit, v):
+        a, k = bit_byte(bit), bit & 7
+        x = self.rd(a, True)
+        if v == "1":
+            return self.wr(a, "%s | 0x%02X" % (x, 1 << k))
+        if v == "0":
+            return self.wr(a, "%s & 0x%02X" % (x, ~(1 << k) & 0xFF))
+        return self.wr(a, "(%s & 0x%02X) | %s << %d"
+                       % (x, ~(1 << k) & 0xFF, v, k))
+
+    def dptr(self):
+        if self.local_dptr:
+            return "dptr"
+        return "(c.iram[0x83] << 8 | c.iram[0x82])"
+
+    def set_dptr(self, v):
+        if self.local_dptr:
+            return ["dptr = (%s) & 0xFFFF;" % v]
+        return ["{", " unsigned d = %s;" % v, " c.iram[0x82] = d;",
+                " c.iram[0x83] = d >> 8;", "}"]
+
+    def psw(self, keep, bits):
+        """Update the kept flags; bits maps a flag to its 0/1 expression."""
+        keep &= sum(bits)
+        if not keep:
+            return []
+        e = "(c.iram[0xD0] & 0x%02X)" % (~keep & 0xFF)
+        for f, x in sorted(bits.items(), reverse=True):
+            if keep & f:
+                e += " | (%s) << %d" % (x, f.bit_length() - 1)
+        return ["c.iram[0xD0] = %s;" % e]
+
+    # Stack
+
+    def push(self, v, sp):
+        return ["unsigned %s = (c.iram[0x81] + 1) & 0xFF;" % sp,
+                "c.iram[0x81] = %s;" % sp,
+                "%s = %s;" % (self.ind(sp), v)]
+
+    def alias(self, a):
+        """After a write through @Ri or SP on a core without the upper 128
+        bytes: the write may have hit DPTR, PSW or ACC."""
+        if not self.classic:
+            return []
+        out = ["if (%s & 0x80)" % a, "{"]
+        if self.local_dptr:
+            out.append(" dptr = c.iram[0x83] << 8 | c.iram[0x82];")
+        if self.local_bank:
+            out.append(" bank = c.iram[0xD0] & 0x18;")
+        out.append(" c.iram[0xD0] = (c.iram[0xD0] & 0xFE) | "
+                   "i8051_parity(c.iram[0xE0]);")
+        if self.fold:
+            out += [" if (c.iram[0xD0] & 0x18)", " {"] + \
+                   ["  " + x for x in self.leave(self.after, "FOLD")] + [" }"]
+        return out + ["}"]
+
+    # Exits
+
+    def leave(self, pc, how=None):
+        out = []
+        if self.local_dptr:
+            out += ["c.iram[0x82] = dptr;", "c.iram[0x83] = dptr >> 8;"]
+        out.append("c.instrs += %d;" % self.n)
+        out.append("c.cycles += %d;" % self.cyc)
+        if isinstance(pc, str):
+            return out + ["c.pc = %s;" % pc, "goto dispatch;"]
+        out.append("c.pc = 0x%04X;" % pc)
+        if how:
+            out.append("return I8051_BLOCK_%s;" % how)
+        elif pc in self.p.halts:
+            out.append("return I8051_BLOCK_HALT;")
+        elif pc in self.p.leaders:
+            out += ["if (c.instrs < max)", " goto B_%04X;" % pc,
+                    "return I8051_BLOCK_LIMIT;"]
+        else:
+            out.append("goto dispatch;")
+        return out
+
+    def branch(self, cond, i):
+        return ["if (%s)" % cond, "{"] + \
+               [" " + x for x in self.leave(i.target)] + ["}"] + \
+            self.leave(i.next)
+
+    # Instructions
+
+    def insn(self, i, keep):
+        m, kinds, op = i.mnemonic, i.kinds(), i.op
+        out = []
+        ind = "IND" in kinds and m != "movx"
+        if ind:
+            out.append("unsigned ia = %s;" % self.reg(op & 1))
+        if self.classic and self.local_dptr and (ind or m in STACK):
+            out += ["c.iram[0x82] = dptr;", "c.iram[0x83] = dptr >> 8;"]
+        if m in ("add", "addc", "subb"):
+            out.append("unsigned a = c.iram[0xE0], v = %s, ci = %s;"
+                       % (self.src(i, 1), "0" if m == "add"
+                          else "c.iram[0xD0] >> 7"))
+            if m == "subb":
+                out += self.psw(keep, {
+                    CY: "a < v + ci",
+                    AC: "(a & 0x0F) < (v & 0x0F) + ci",
+                    OV: "((a & 0x7F) < (v & 0x7F) + ci) != (a < v + ci)"})
+                out.append("c.iram[0xE0] = a - v - ci;")
+            else:
+                out.append("unsigned r = a + v + ci;")
+                out += self.psw(keep, {
+                    CY: "r > 0xFF",
+                    AC: "(a & 0x0F) + (v & 0x0F) + ci > 0x0F",
+                    OV: "((a & 0x7F) + (v & 0x7F) + ci > 0x7F) != (r > 0xFF)"})
+                out.append("c.iram[0xE0] = r;")
+        elif m in ("anl", "orl", "xrl"):
+            o = {"anl": "&", "orl": "|", "xrl": "^"}[m]
+            if kinds[0] == "C":
+                v = self.src(i, 1)
+                if m == "anl":
+                    out += ["if (!%s)" % v, " c.iram[0xD0] &= 0x7F;"]
+                else:
+                    out += ["if (%s)" % v, " c.iram[0xD0] |= 0x80;"]
+            else:
+                v = self.src(i, 1)
+                out += self.modify(i, 0, lambda x: "%s %s %s" % (x, o, v))
+        elif m == "mov":
+            if kinds[0] == "C":
+                out += self.psw(keep, {CY: self.src(i, 1)})
+            elif kinds[0] == "BIT":
+                out += self.set_bit(i.val(0), "(c.iram[0xD0] >> 7)")
+            elif kinds[0] == "DPTR":
+                out += self.set_dptr("0x%04X" % (i.b[1] << 8 | i.b[2]))
+            else:
+                out += self.put(i, 0, self.src(i, 1))
+        elif m == "movc":
+            base = self.dptr() if kinds[1] == "CODE_DPTR" \
+                else "0x%04X" % i.next
+            out.append("c.iram[0xE0] = c.code[(c.iram[0xE0] + %s) & 0xFFFF];"
+                       % base)
+        elif m == "movx":
+            if "XDPTR" in kinds:
+                x = "c.xdata[%s]" % self.dptr()
+            else:
+                x = "c.xdata[c.iram[0xA0] << 8 | %s]" % self.reg(op & 1)
+            if kinds[0] == "A":
+                out.append("c.iram[0xE0] = %s;" % x)
+            else:
+                out.append("%s = c.iram[0xE0];" % x)
+        elif m in ("inc", "dec"):
+            if kinds[0] == "DPTR":
+                out += self.set_dptr(self.dptr() + " + 1")
+            else:
+                out += self.modify(i, 0, lambda x: "%s %s 1"
+                                   % (x, "+" if m == "inc" else "-"))
+        elif m == "mul":
+            out += ["unsigned t = c.iram[0xE0] * c.iram[0xF0];",
+                    "c.iram[0xE0] = t;", "c.iram[0xF0] = t >> 8;"]
+            out += self.psw(keep, {CY: "0", OV: "t > 0xFF"})
+        elif m == "div":
+            out += ["unsigned t = c.iram[0xF0];", "if (t)", "{",
+                    " unsigned q = c.iram[0xE0] / t;",
+                    " c.iram[0xF0] = c.iram[0xE0] % t;",
+                    " c.iram[0xE0] = q;", "}"]
+            out += self.psw(keep, {CY: "0", OV: "t == 0"})
+        elif m == "da":
+            out += ["unsigned t = c.iram[0xE0];",
+                    "if ((t & 0x0F) > 9 || (c.iram[0xD0] & 0x40))",
+                    " t += 0x06;",
+                    "if (t > 0xFF)", " c.iram[0xD0] |= 0x80;",
+                    "if ((t & 0x1F0) > 0x90 || (c.iram[0xD0] & 0x80))",
+                    " t += 0x60;",
+                    "if (t > 0xFF)", " c.iram[0xD0] |= 0x80;",
+                    "c.iram[0xE0] = t;"]
+        elif m in ("clr", "setb", "cpl"):
+            if kinds[0] == "A":
+                out.append("c.iram[0xE0] = %s;" % ("0" if m == "clr"
+                                                   else "~c.iram[0xE0]"))
+            elif kinds[0] == "C":
+                if m == "cpl":
+                    out.append("c.iram[0xD0] ^= 0x80;")
+                else:
+                    out += self.psw(keep, {CY: "1" if m == "setb" else "0"})
+            elif m == "cpl":
+                a = bit_byte(i.val(0))
+                out += self.wr(a, "%s ^ 0x%02X" % (self.rd(a, True),
+                                                   1 << (i.val(0) & 7)))
+            else:
+                out += self.set_bit(i.val(0), "1" if m == "setb" else "0")
+        elif m in ("rl", "rr", "swap"):
+            out.append("unsigned a = c.iram[0xE0];")
+            out.append("c.iram[0xE0] = %s;" % {
+                "rl": "a << 1 | a >> 7", "rr": "a >> 1 | a << 7",
+                "swap": "a << 4 | a >> 4"}[m])
+        elif m == "rlc":
+            out += ["unsigned a = c.iram[0xE0];",
+                    "c.iram[0xE0] = a << 1 | c.iram[0xD0] >> 7;"]
+            out += self.psw(keep, {CY: "a >> 7"})
+        elif m == "rrc":
+            out += ["unsigned a = c.iram[0xE0];",
+                    "c.iram[0xE0] = a >> 1 | (c.iram[0xD0] & 0x80);"]
+            out += self.psw(keep, {CY: "a & 1"})
+        elif m == "xch":
+            out += ["unsigned t = c.iram[0xE0];",
+                    "c.iram[0xE0] = %s;" % self.src(i, 1)]
+            out += self.put(i, 1, "t")
+        elif m == "xchd":
+            x = self.ind("ia")
+            out += ["unsigned t = %s;" % x,
+                    "%s = (t & 0xF0) | (c.iram[0xE0] & 0x0F);" % x,
+                    "c.iram[0xE0] = (c.iram[0xE0] & 0xF0) | (t & 0x0F);"]
+        elif m == "push":
+            out += self.push(self.src(i, 0), "sp")
+            out += self.alias("sp")
+        elif m == "pop":
+            out += ["unsigned sp = c.iram[0x81], t = %s;" % self.ind("sp"),
+                    "c.iram[0x81] = sp - 1;"]
+            out += self.put(i, 0, "t")
+        elif m in ("nop", "reserved"):
+            pass
+        elif m in ("jc", "jnc", "jz", "jnz", "jb", "jnb"):
+            if m in ("jb", "jnb"):
+                cond = ("" if m == "jb" else "!") + self.src(i, 0)
+            else:
+                cond = {"jc": "c.iram[0xD0] & 0x80",
+                        "jnc": "!(c.iram[0xD0] & 0x80)",
+                        "jz": "c.iram[0xE0] == 0",
+                        "jnz": "c.iram[0xE0] != 0"}[m]
+            return out, cond
+        elif m == "jbc":
+            a = bit_byte(i.val(0))
+            k = 1 << (i.val(0) & 7)
+            out += ["if (%s & 0x%02X)" % (self.rd(a, True), k), "{"]
+            out += [" " + x for x in self.wr(a, "%s & 0x%02X"
+                                             % (self.rd(a, True), ~k & 0xFF))]
+            out += [" " + x for x in self.leave(i.target)] + ["}"]
+            return out, None
+        elif m == "cjne":
+            out.append("unsigned x = %s, y = %s;"
+                       % (self.src(i, 0), self.src(i, 1)))
+            out += self.psw(keep, {CY: "x < y"})
+            return out, "x != y"
+        elif m == "djnz":
+            if kinds[0] == "DIR":
+                out.append("unsigned t = (%s - 1) & 0xFF;"
+                           % self.rd(i.val(0), True))
+                out += self.wr(i.val(0), "t")
+            else:
+                out += ["unsigned t = (%s - 1) & 0xFF;" % self.reg(op & 7),
+                        "%s = t;" % self.reg(op & 7)]
+            return out, "t"
+        elif m in ("acall", "lcall"):
+            out += self.push("0x%02X" % (i.next & 0xFF), "s1")
+            out += self.push("0x%02X" % (i.next >> 8), "s2")
+            out += self.alias("(s1 | s2)")
+        elif m in ("ret", "reti"):
+            out += ["unsigned sp = c.iram[0x81], t = %s << 8;"
+                    % self.ind("sp"),
+                    "sp = (sp - 1) & 0xFF;",
+                    "t |= %s;" % self.ind("sp"),
+                    "c.iram[0x81] = sp - 1;"]
+        elif m in ("sjmp", "ajmp", "ljmp", "jmp"):
+            pass
+        else:
+            raise ValueError("i8051_blockgen: no code for %s" % i.syntax)
+        if ind and (kinds[0] == "IND" or m in ("xch", "xchd")) and \
+                m != "cjne":
+            out += self.alias("ia")
+        if keep & P:
+            out.append("c.iram[0xD0] = (c.iram[0xD0] & 0xFE) | "
+                       "i8051_parity(c.iram[0xE0]);")
+        return out, None
+
+    def emit(self):
+        insns = self.insns
+        # Backward flag liveness; every flag is live at the block exits.
+        keep, live = [0] * len(insns), ALL
+        for k in range(len(insns) - 1, -1, -1):
+            rd, wr = flags(insns[k], self.p.is8052)
+            keep[k] = wr & live
+            live = (live & ~wr) | rd
+        lines = ["B_%04X:" % insns[0].addr, "{"]
+        if self.local_bank:
+            lines.append(" unsigned bank = c.iram[0xD0] & 0x18;")
+        if self.local_dptr:
+            lines.append(" unsigned dptr = c.iram[0x83] << 8 | c.iram[0x82];")
+        for k, i in enumerate(insns):
+            self.n += 1
+            self.cyc += self.p.cycles[i.op]
+            self.after = i.target if i.mnemonic in ("acall", "lcall") \
+                else i.next
+            body, cond = self.insn(i, keep[k])
+            m = i.mnemonic
+            if cond is not None:
+                body += self.branch(cond, i)
+            elif m in ("sjmp", "ajmp", "ljmp", "acall", "lcall", "jbc"):
+                body += self.leave(i.target if m != "jbc" else i.next)
+            elif m in ("ret", "reti"):
+                body += self.leave("t")
+            elif m == "jmp":
+                body += self.leave("(c.iram[0xE0] + %s) & 0xFFFF"
+                                   % self.dptr())
+            elif k == len(insns) - 1:
+                body += self.leave(i.next)
+            lines.append(" // " + i.text())
+            if body:
+                lines += [" {"] + ["  " + x for x in body] + [" }"]
+        return lines + ["}"]
+
+
+def generate(prog, image, out):
+    addrs = sorted(prog.leaders)
+    blocks = [Block(prog, prog.block(a)) for a in addrs]
+    ranges = []
+    for a in sorted(prog.insns):
+        i = prog.insns[a]
+        if ranges and ranges[-1][1] >= a:
+            ranges[-1][1] = max(ranges[-1][1], a + i.size)
+        else:
+            ranges.append([a, a + i.size])
+    w = out.write
+    w("// Generated by tools/i8051_blockgen.py from %s; do not edit.\n"
+      % os.path.basename(image))
+    w("// %d blocks, %d instructions, register banks %s, %s core.\n\n"
+      % (len(blocks), len(prog.insns),
+         "folded" if prog.fold else "per block",
+         "8052" if prog.is8052 else "8051"))
+    w('#include "i8051_block.H"\n\n')
+    w("const bool i8051_block_8052 = %s;\n\n"
+      % ("true" if prog.is8052 else "false"))
+    w("//! Code bytes the blocks were compiled from.\n")
+    w("static const unsigned short i8051_block_ranges[][2] = {\n")
+    for lo, hi in ranges:
+        w(" { 0x%04X, 0x%04X },\n" % (lo, min(hi, 0xFFFF)))
+    w(" { 0, 0 }\n};\n\nstatic const unsigned char i8051_block_bytes[] = {")
+    n = 0
+    for lo, hi in ranges:
+        for a in range(lo, min(hi, 0xFFFF)):
+            w(("\n " if n % 16 == 0 else " ") + "0x%02X," % prog.code[a])
+            n += 1
+    w("\n 0\n};\n\n")
+    w("""bool i8051_block_match(const i8051_core& c)
+{
+ const unsigned char* p = i8051_block_bytes;
+ int k;
+
+ for (k = 0; i8051_block_ranges[k][1] != 0; k++)
+ {
+  unsigned n = i8051_block_ranges[k][1] - i8051_block_ranges[k][0];
+
+  if (memcmp(c.code + i8051_block_ranges[k][0], p, n) != 0)
+   return false;
+  p += n;
+ }
+ return true;
+}
+
+int i8051_block_run(i8051_core& c, unsigned long long max)
+{
+""")
+    if prog.fold:
+        w(" if (c.iram[0xD0] & 0x18)\n  return I8051_BLOCK_FOLD;\n")
+    w(" goto dispatch;\n\n")
+    for b in blocks:
+        w("\n".join(b.emit()) + "\n\n")
+    w(""" dispatch:
+ if (c.instrs >= max)
+  return I8051_BLOCK_LIMIT;
+ switch (c.pc)
+ {
+""")
+    for a in addrs:
+        w("  case 0x%04X: goto B_%04X;\n" % (a, a))
+    for a in sorted(prog.halts):
+        w("  case 0x%04X: return I8051_BLOCK_HALT;\n" % a)
+    w(""" }
+ // Not found statically: interpret.
+ if (c.code[c.pc] == 0x80 && c.code[(c.pc + 1) & 0xFFFF] == 0xFE)
+  return I8051_BLOCK_HALT;
+ c.step();
+""")
+    if prog.fold:
+        w(" if (c.iram[0xD0] & 0x18)\n  return I8051_BLOCK_FOLD;\n")
+    w(" goto dispatch;\n}\n")
+    w("\n#ifdef I8051_BLOCK_MAIN\nint main(int argc, char** argv)\n{\n"
+      " return i8051_block_main(argc, argv);\n}\n#endif\n")
+
+
+def main():
+    ap = argparse.ArgumentParser(
+        description="Compile an i8051 image into a block-level simulator.")
+    ap.add_argument("image", help="Intel HEX or raw binary image")
+    ap.add_argument("-e", "--entry", action="append", default=[],
+                    type=lambda s: int(s, 0),
+                    help="extra entry point, e.g. a jmp @A+DPTR target")
+    ap.add_argument("--8052", dest="is8052", action="store_true",
+                    help="8052 core: @Ri above 0x7F is the upper RAM")
+    ap.add_argument("-o", "--output", help="output file (default: stdout)")
+    args = ap.parse_args()
+    code, used = load_image(args.image)
+    prog = Program(code, used, [0] + args.entry, args.is8052)
+    out = open(args.output, "w") if args.output else sys.stdout
+    generate(prog, args.image, out)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,261 @@
+/**
+ * @file      i8051_dis.cpp
+ * @author    The ArchC Team
+ *            http://www.archc.org/
+ *
+ *            Computer Systems Laboratory (LSC)
+ *            IC-UNICAMP
+ *            http://www.lsc.ic.unicamp.br/
+ *
+ * @version   1.0
+ * @date      Thu, 22 Oct 2026 11:30:05 -0300
+ *
+ * @brief     Batch disassembler for images and PC traces.
+ *
+ * Without -t the code of the image is listed from its lowest to its
+ * highest loaded address, one instruction per line with its address
+ * and bytes; every address some jump, branch or call in the image
+ * targets gets an "Lxxxx:" label line. The sweep is linear, so tables
+ * placed in code come out as instructions.
+ *
+ * With -t each line of the trace (or of stdin) is copied with the
+ * disassembly of the instruction at its PC appended; the PC is the hex
+ * number in whitespace separated field -k (default 1: one PC per line;
+ * 2 for an I8051_WATCH log). Lines without one are copied unchanged.
+ * Text is cached per PC, so the cost per line is parsing the PC and
+ * copying bytes; input and output go through large buffers.
+ *
+ *     g++ -O2 -I.. -o i8051_dis i8051_dis.cpp
+ *     ./i8051_dis image
+ *     ./i8051_dis -t [-k field] image [trace]
+ *
+ * @attention Copyright (C) 2002-2006 --- The ArchC Team
+ *
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+#include "i8051_disasm.H"
+#include "i8051_loader.H"
+
+#define BUF_SIZE (1 << 20)
+#define TEXT_SLOT (I8051_DISASM_MAX + 16)
+
+static unsigned char code[0x10000 + 2];   // +2 so the last bytes wrap
+static char out_buf[BUF_SIZE + TEXT_SLOT];
+static unsigned out_len;
+
+static void flush()
+{
+ fwrite(out_buf, 1, out_len, stdout);
+ out_len = 0;
+}
+
+static inline void put(const char* s, unsigned n)
+{
+ if (out_len + n > BUF_SIZE)
+  flush();
+ memcpy(out_buf + out_len, s, n);
+ out_len += n;
+}
+
+//! Instruction bytes at pc, wrapping at the end of code memory.
+static inline const unsigned char* at(unsigned pc)
+{
+ return code + pc;
+}
+
+static inline char* hex4(char* p, unsigned v)
+{
+ p[0] = i8051_hexdigit[(v >> 12) & 15];
+ p[1] = i8051_hexdigit[(v >> 8) & 15];
+ p[2] = i8051_hexdigit[(v >> 4) & 15];
+ p[3] = i8051_hexdigit[v & 15];
+ return p + 4;
+}
+
+static void listing(unsigned lo, unsigned hi)
+{
+ static unsigned char label[0x10000];
+ char line[80 + I8051_DISASM_MAX];
+ unsigned pc, k, n;
+ int t;
+
+ for (pc = lo; pc < hi; pc += i8051_optable[code[pc]].length)
+  if ((t = i8051_disasm_target(at(pc), pc)) >= 0)
+   label[t] = 1;
+ for (pc = lo; pc < hi; pc += n)
+ {
+  char* p = line;
+
+  if (label[pc])
+  {
+   *p++ = 'L';
+   p = hex4(p, pc);
+   *p++ = ':';
+   *p++ = '\n';
+  }
+  p = hex4(p, pc);
+  *p++ = ' ';
+  *p++ = ' ';
+  n = i8051_optable[code[pc]].length;
+  for (k = 0; k < 3; k++)
+   if (k < n)
+   {
+    *p++ = i8051_hexdigit[code[pc + k] >> 4];
+    *p++ = i8051_hexdigit[code[pc + k] & 15];
+    *p++ = ' ';
+   }
+   else
+   {
+    memcpy(p, "   ", 3);
+    p += 3;
+   }
+  *p++ = ' ';
+  i8051_disasm(at(pc), pc, p);
+  p += strlen(p);
+  *p++ = '\n';
+  put(line, p - line);
+ }
+}
+
+//! Cached text of the instruction at each PC, "  " first and "\n"
+//! last; whole slots are copied, which is cheaper than exact lengths.
+
+static char text[0x10000][TEXT_SLOT];
+static unsigned char text_len[0x10000];
+
+static inline char* put_insn(char* o, unsigned pc)
+{
+ if (text_len[pc] == 0)
+ {
+  text[pc][0] = ' ';
+  text[pc][1] = ' ';
+  i8051_disasm(at(pc), pc, text[pc] + 2);
+  text_len[pc] = strlen(text[pc]) + 1;
+  text[pc][text_len[pc] - 1] = '\n';
+ }
+ memcpy(o, text[pc], TEXT_SLOT);
+ return o + text_len[pc];
+}
+
+//! Copy one trace line (without its '\n') with the disassembly added.
+static inline void trace_line(const char* s, const char* end, unsigned field)
+{
+ const char* p = s;
+ unsigned pc = 0, digits = 0;
+ int v;
+
+ while (true)
+ {
+  while (p < end && (*p == ' ' || *p == '\t'))
+   p++;
+  if (--field == 0 || p == end)
+   break;
+  while (p < end && *p != ' ' && *p != '\t')
+   p++;
+ }
+ if (p + 1 < end && p[0] == '0' && (p[1] == 'x' || p[1] == 'X'))
+  p += 2;
+ while (p < end && (v = i8051_hexval(*p)) >= 0)
+ {
+  pc = (pc << 4) | v;
+  p++;
+  digits++;
+ }
+ if (end > s && end[-1] == '\r')
+  end--;
+ if (out_len + (end - s) + TEXT_SLOT > BUF_SIZE)
+  flush();
+
+ char* o = out_buf + out_len;
+
+ memcpy(o, s, end - s);
+ o += end - s;
+ if (field == 0 && digits > 0 && digits <= 4 &&
+     (p == end || *p == ' ' || *p == '\t' || *p == ':' || *p == '\r'))
+  o = put_insn(o, pc);
+ else
+  *o++ = '\n';
+ out_len = o - out_buf;
+}
+
+static bool trace(FILE* in, unsigned field)
+{
+ static char buf[BUF_SIZE];
+ size_t have = 0, n;
+
+ while ((n = fread(buf + have, 1, BUF_SIZE - have, in)) > 0 || have > 0)
+ {
+  char* s = buf;
+  char* end = buf + have + n;
+  char* nl;
+
+  while ((nl = (char*) memchr(s, '\n', end - s)) != NULL)
+  {
+   trace_line(s, nl, field);
+   s = nl + 1;
+  }
+  have = end - s;
+  if (n == 0 || have == BUF_SIZE)
+  {
+   // last line without '\n', or one longer than the buffer
+   trace_line(s, end, field);
+   have = 0;
+   continue;
+  }
+  memmove(buf, s, have);
+ }
+ return !ferror(in);
+}
+
+int main(int argc, char** argv)
+{
+ const char* usage = "usage: %s [-t [-k field]] image [trace]\n";
+ unsigned field = 1;
+ bool tr = false;
+ i8051_image img;
+ FILE* in = stdin;
+ int o;
+
+ while ((o = getopt(argc, argv, "tk:")) != -1)
+  switch (o)
+  {
+   case 't': tr = true; break;
+   case 'k': field = atoi(optarg); break;
+   default:
+    fprintf(stderr, usage, argv[0]);
+    return 2;
+  }
+ if (optind >= argc || field == 0 || argc - optind > (tr ? 2 : 1))
+ {
+  fprintf(stderr, usage, argv[0]);
+  return 2;
+ }
+ memset(&img, 0, sizeof(img));
+ img.code = code;
+ if (!i8051_load(argv[optind], &img))
+  return 2;
+ code[0x10000] = code[0];
+ code[0x10001] = code[1];
+ if (!tr)
+  listing(img.code_lo, img.code_hi);
+ else
+ {
+  if (optind + 1 < argc && (in = fopen(argv[optind + 1], "rb")) == NULL)
+  {
+   fprintf(stderr, "i8051: cannot open trace '%s'\n", argv[optind + 1]);
+   return 2;
+  }
+  if (!trace(in, field))
+  {
+   fprintf(stderr, "i8051: error reading the trace\n");
+   return 2;
+  }
+ }
+ flush();
+ return 0;
+}
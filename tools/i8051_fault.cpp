@@ -0,0 +1,621 @@
+/**
+ * @file      i8051_fault.cpp
+ * @author    The ArchC Team
+ *            http://www.archc.org/
+ *
+ *            Computer Systems Laboratory (LSC)
+ *            IC-UNICAMP
+ *            http://www.lsc.ic.unicamp.br/
+ *
+ * @version   1.0
+ * @date      Tue, 20 Oct 2026 11:02:18 -0300
+ *
+ * @brief     Single-event upset injection campaigns.
+ *
+ * A program is run once on the reference core (i8051_core.H) to the
+ * "sjmp $" at its end; this golden run leaves about a thousand
+ * checkpoints of the complete state. Every injection then starts from
+ * the last checkpoint before its cycle, runs up to that cycle, flips
+ * one bit and continues. At each later checkpoint the state is compared
+ * with the golden one, and the run stops early as masked once they are
+ * equal again. Otherwise the outcome is
+ *
+ *     masked  the program stops with the golden outputs
+ *     sdc     it stops, but the outputs differ (silent data corruption)
+ *     crash   it executes the reserved opcode or leaves the program image
+ *     hang    it runs longer than the hang limit
+ *
+ * Outputs are XDATA, the port latches and, with -r, an IRAM range.
+ * XDATA is compared through a digest kept up to date on every MOVX
+ * write, so checkpoints compare in constant time. Injections are spread
+ * over threads.
+ *
+ *     g++ -O2 -pthread -I.. -o i8051_fault i8051_fault.cpp
+ *     ./i8051_fault [options] image
+ *
+ *     -n <count>     random injections (default 10000)
+ *     -t <targets>   comma separated: iram, idata (8052 upper bank),
+ *                    xdata, sfr, psw, sp, pc (default iram,psw,sp,pc)
+ *     -x <lo>-<hi>   XDATA range for the xdata target (default: what
+ *                    the image initializes, or all of it)
+ *     -r <lo>-<hi>   IRAM range that is part of the output
+ *     -f <file>      injections from file, one "cycle target addr bit"
+ *                    per line, instead of random ones
+ *     -l <factor>    hang limit in golden run lengths (default 2)
+ *     -o <file>      one CSV line per injection
+ *     -j <threads>   -s <seed>   -8 (8052 upper bank)
+ *
+ * @attention Copyright (C) 2002-2006 --- The ArchC Team
+ *
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+#include "i8051_core.H"
+#include "i8051_loader.H"
+#include "i8051_optable.H"
+
+enum target { T_IRAM, T_IDATA, T_XDATA, T_SFR, T_PSW, T_SP, T_PC, T_COUNT };
+
+static const char* const target_name[T_COUNT] = {
+ "iram", "idata", "xdata", "sfr", "psw", "sp", "pc"
+};
+
+enum outcome { MASKED, SDC, CRASH, HANG, O_COUNT };
+
+static const char* const outcome_name[O_COUNT] = {
+ "masked", "sdc", "crash", "hang"
+};
+
+struct injection
+{
+ unsigned long long cycle;
+ unsigned char target;
+ unsigned addr, bit;
+ // Result
+ unsigned char outcome;
+ bool early;                    // reconverged at a checkpoint
+ unsigned long long instrs;     // instructions run after the flip
+};
+
+//! Complete machine state at an instruction boundary.
+struct checkpoint
+{
+ unsigned char iram[256], idata[256];
+ unsigned pc;
+ unsigned long long cycles, instrs, digest;
+ unsigned xdata;                // index into campaign::xdata
+};
+
+struct campaign
+{
+ i8051_core* golden;            // program and initial state
+ unsigned code_lo, code_hi;
+ std::vector<checkpoint> cp;
+ std::vector<std::vector<unsigned char> > xdata;
+ unsigned long long instrs, cycles, hang;
+ // Golden outputs
+ unsigned long long digest;
+ unsigned char ports[4];
+ unsigned char iram[256];
+ unsigned out_lo, out_hi;       // IRAM output range, empty if lo > hi
+ // Last golden instruction that may read each RAM byte: IRAM 00-7F,
+ // then the upper bank 80-FF.
+ unsigned long long last_read[256];
+};
+
+//! Digest term of XDATA byte a holding v (splitmix64).
+static inline unsigned long long xhash(unsigned a, unsigned v)
+{
+ unsigned long long z = ((unsigned long long) a << 8 | v) +
+                        0x9E3779B97F4A7C15ULL;
+
+ z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+ z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+ return z ^ (z >> 31);
+}
+
+static unsigned long long xdigest(const unsigned char* x)
+{
+ unsigned long long d = 0;
+
+ for (unsigned a = 0; a < 0x10000; a++)
+  d += xhash(a, x[a]);
+ return d;
+}
+
+//! One step that keeps the XDATA digest current.
+static inline void step(i8051_core& c, unsigned long long& digest)
+{
+ unsigned op = c.code[c.pc], a, old;
+
+ if (op == 0xF0 || op == 0xF2 || op == 0xF3)
+ {
+  a = op == 0xF0 ? c.dptr() :
+      (c.iram[I8051_P2] << 8) | c.iram[(c.iram[I8051_PSW] & 0x18) | (op & 1)];
+  old = c.xdata[a];
+  c.step();
+  digest += xhash(a, c.xdata[a]) - xhash(a, old);
+ }
+ else
+  c.step();
+}
+
+static inline bool halted(const i8051_core& c)
+{
+ return c.code[c.pc] == 0x80 && c.code[(c.pc + 1) & 0xFFFF] == 0xFE;
+}
+
+static inline bool crashed(const campaign& g, const i8051_core& c)
+{
+ return c.pc - g.code_lo >= g.code_hi - g.code_lo || c.code[c.pc] == 0xA5;
+}
+
+static void save(const i8051_core& c, unsigned long long digest, checkpoint& p)
+{
+ memcpy(p.iram, c.iram, 256);
+ memcpy(p.idata, c.idata, 256);
+ p.pc = c.pc;
+ p.cycles = c.cycles;
+ p.instrs = c.instrs;
+ p.digest = digest;
+}
+
+//! c matches checkpoint p up to RAM bytes that the golden run never
+//! reads again and that are not outputs. From here on c executes exactly
+//! as the golden run did, so the fault is masked.
+static bool reconverged(const campaign& g, const i8051_core& c,
+                        unsigned long long digest, const checkpoint& p)
+{
+ unsigned a;
+
+ if (c.pc != p.pc || c.cycles != p.cycles || digest != p.digest ||
+     memcmp(c.iram + 0x80, p.iram + 0x80, 0x80) != 0)
+  return false;
+ for (a = 0; a < 256; a++)
+  if ((a < 0x80 ? c.iram[a] != p.iram[a] : c.idata[a] != p.idata[a]) &&
+      (g.last_read[a] >= p.instrs || (a >= g.out_lo && a <= g.out_hi)))
+   return false;
+ return true;
+}
+
+//! RAM byte a as an index of campaign::last_read; -1 for SFRs.
+static inline int ram_index(const i8051_core& c, unsigned a, bool indirect)
+{
+ if (a < 0x80)
+  return a;
+ return indirect && c.is8052 ? a : -1;
+}
+
+//! Record the RAM bytes the instruction at c.pc may read. Conservative:
+//! every byte an operand names counts, written or not.
+static void note_reads(const i8051_core& c, unsigned long long n,
+                       unsigned long long* last)
+{
+ unsigned op = c.code[c.pc], bank = c.iram[I8051_PSW] & 0x18, i, a;
+ const i8051_opinfo& o = i8051_optable[op];
+ int k;
+
+ for (i = 0; i < o.nopd; i++)
+ {
+  a = c.code[(c.pc + o.opd[i].byte) & 0xFFFF];
+  switch (o.opd[i].kind)
+  {
+   case I8051_OPD_REG:
+    last[bank | (op & 7)] = n;
+    break;
+   case I8051_OPD_IND:
+    last[bank | (op & 1)] = n;
+    if ((k = ram_index(c, c.iram[bank | (op & 1)], true)) >= 0)
+     last[k] = n;
+    break;
+   case I8051_OPD_DIR:
+    if (a < 0x80)
+     last[a] = n;
+    break;
+   case I8051_OPD_BIT: case I8051_OPD_NBIT:
+    if (a < 0x80)
+     last[0x20 + (a >> 3)] = n;
+    break;
+  }
+ }
+ // The stack: POP, RET and RETI read at SP and SP - 1.
+ if (op == 0xD0 || op == 0x22 || op == 0x32)
+  for (i = 0; i < 2; i++)
+   if ((k = ram_index(c, (c.iram[I8051_SP] - i) & 0xFF, true)) >= 0)
+    last[k] = n;
+}
+
+//! c to the initial state of the program.
+static void start(const campaign& g, i8051_core* c)
+{
+ memcpy(c->iram, g.golden->iram, 256);
+ memcpy(c->idata, g.golden->idata, 256);
+ memcpy(c->xdata, g.golden->xdata, 0x10000);
+ c->pc = g.golden->pc;
+ c->is8052 = g.golden->is8052;
+ c->cycles = c->instrs = 0;
+}
+
+//! Golden run: length first, then again leaving checkpoints.
+static bool run_golden(campaign& g, unsigned long long max)
+{
+ i8051_core* c = new i8051_core;
+ unsigned long long digest, interval;
+ unsigned i;
+
+ memcpy(c->code, g.golden->code, 0x10000);
+ start(g, c);
+ while (!halted(*c))
+ {
+  if (crashed(g, *c) || c->instrs >= max)
+  {
+   fprintf(stderr, "i8051_fault: golden run does not end in \"sjmp $\" "
+                   "(pc %04x after %llu instructions)\n", c->pc, c->instrs);
+   delete c;
+   return false;
+  }
+  c->step();
+ }
+ g.instrs = c->instrs;
+ g.cycles = c->cycles;
+ g.hang = g.instrs;
+
+ interval = g.instrs / 1024 > 256 ? g.instrs / 1024 : 256;
+ start(g, c);
+ digest = xdigest(c->xdata);
+ memset(g.last_read, 0, sizeof(g.last_read));
+ for (;;)
+ {
+  if (c->instrs % interval == 0 || halted(*c))
+  {
+   g.cp.push_back(checkpoint());
+   save(*c, digest, g.cp.back());
+   // XDATA copies are shared between checkpoints until it changes.
+   if (g.cp.size() == 1 || g.cp[g.cp.size() - 2].digest != digest)
+    g.xdata.push_back(std::vector<unsigned char>(c->xdata,
+                                                 c->xdata + 0x10000));
+   g.cp.back().xdata = g.xdata.size() - 1;
+  }
+  if (halted(*c))
+   break;
+  note_reads(*c, c->instrs, g.last_read);
+  step(*c, digest);
+ }
+ g.digest = digest;
+ for (i = 0; i < 4; i++)
+  g.ports[i] = c->iram[0x80 + 0x10 * i];
+ memcpy(g.iram, c->iram, 256);
+ delete c;
+ return true;
+}
+
+static bool same_output(const campaign& g, const i8051_core& c,
+                        unsigned long long digest)
+{
+ unsigned i;
+
+ if (digest != g.digest)
+  return false;
+ for (i = 0; i < 4; i++)
+  if (c.iram[0x80 + 0x10 * i] != g.ports[i])
+   return false;
+ return g.out_lo > g.out_hi ||
+        memcmp(c.iram + g.out_lo, g.iram + g.out_lo,
+               g.out_hi - g.out_lo + 1) == 0;
+}
+
+static void flip(i8051_core& c, unsigned long long& digest, const injection& j)
+{
+ unsigned char* p;
+
+ switch (j.target)
+ {
+  case T_PC:
+   c.pc ^= 1 << j.bit;
+   return;
+  case T_XDATA:
+   digest -= xhash(j.addr, c.xdata[j.addr]);
+   c.xdata[j.addr] ^= 1 << j.bit;
+   digest += xhash(j.addr, c.xdata[j.addr]);
+   return;
+  case T_IDATA:
+   p = &c.idata[j.addr];
+   break;
+  default:
+   p = &c.iram[j.addr];
+   break;
+ }
+ *p ^= 1 << j.bit;
+}
+
+//! Run one injection on c, which holds the program.
+static void inject(const campaign& g, i8051_core& c, injection& j)
+{
+ unsigned long long digest, from;
+ size_t lo = 0, hi = g.cp.size(), k;
+
+ // Last checkpoint at or before the injection cycle.
+ while (hi - lo > 1)
+ {
+  k = (lo + hi) / 2;
+  if (g.cp[k].cycles <= j.cycle)
+   lo = k;
+  else
+   hi = k;
+ }
+ const checkpoint& p = g.cp[lo];
+ memcpy(c.iram, p.iram, 256);
+ memcpy(c.idata, p.idata, 256);
+ memcpy(c.xdata, g.xdata[p.xdata].data(), 0x10000);
+ c.pc = p.pc;
+ c.cycles = p.cycles;
+ c.instrs = p.instrs;
+ digest = p.digest;
+ while (c.cycles < j.cycle && !halted(c))
+  step(c, digest);
+ flip(c, digest, j);
+ from = c.instrs;
+ j.early = false;
+
+ for (k = lo + 1; ; )
+ {
+  while (k < g.cp.size() && g.cp[k].instrs < c.instrs)
+   k++;
+  if (k < g.cp.size() && g.cp[k].instrs == c.instrs &&
+      reconverged(g, c, digest, g.cp[k]))
+  {
+   j.outcome = MASKED;
+   j.early = true;
+   break;
+  }
+  if (halted(c))
+  {
+   j.outcome = same_output(g, c, digest) ? MASKED : SDC;
+   break;
+  }
+  if (crashed(g, c))
+  {
+   j.outcome = CRASH;
+   break;
+  }
+  if (c.instrs >= g.hang)
+  {
+   j.outcome = HANG;
+   break;
+  }
+  step(c, digest);
+ }
+ j.instrs = c.instrs - from;
+}
+
+struct rng
+{
+ unsigned long long x;
+
+ unsigned long long next()
+ {
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  return x;
+ }
+};
+
+static bool parse_range(const char* s, unsigned& lo, unsigned& hi)
+{
+ char* end;
+
+ lo = strtoul(s, &end, 16);
+ if (*end != '-')
+  return false;
+ hi = strtoul(end + 1, &end, 16);
+ return *end == 0 && lo <= hi;
+}
+
+static void usage()
+{
+ fprintf(stderr, "usage: i8051_fault [-n count] [-t targets] [-x lo-hi] "
+                 "[-r lo-hi] [-f file]\n"
+                 "                   [-l factor] [-o file] [-j threads] "
+                 "[-s seed] [-8] image\n");
+ exit(2);
+}
+
+int main(int argc, char** argv)
+{
+ campaign g;
+ std::vector<injection> inj;
+ std::vector<std::thread> pool;
+ std::atomic<size_t> next(0);
+ const char* list = NULL;
+ const char* csv = NULL;
+ unsigned threads = std::thread::hardware_concurrency();
+ unsigned long long count = 10000, seed = 1, tally[O_COUNT] = { 0 }, early = 0;
+ double factor = 2;
+ unsigned xlo = 0, xhi = 0xFFFF, t, i;
+ bool targets[T_COUNT] = { true, false, false, false, true, true, true };
+ bool xrange = false;
+ i8051_image img;
+ rng r;
+ int c;
+
+ g.out_lo = 1;
+ g.out_hi = 0;
+ g.golden = new i8051_core;
+ while ((c = getopt(argc, argv, "n:t:x:r:f:l:o:j:s:8")) != -1)
+  switch (c)
+  {
+   case 'n': count = strtoull(optarg, NULL, 0); break;
+   case 'x':
+    if (!parse_range(optarg, xlo, xhi) || xhi > 0xFFFF)
+     usage();
+    xrange = true;
+    break;
+   case 'r':
+    if (!parse_range(optarg, g.out_lo, g.out_hi) || g.out_hi > 0xFF)
+     usage();
+    break;
+   case 'f': list = optarg; break;
+   case 'l': factor = atof(optarg); break;
+   case 'o': csv = optarg; break;
+   case 'j': threads = atoi(optarg); break;
+   case 's': seed = strtoull(optarg, NULL, 0); break;
+   case '8': g.golden->is8052 = true; break;
+   case 't':
+    {
+     std::string s(optarg);
+
+     memset(targets, 0, sizeof(targets));
+     for (size_t p = 0, e; p <= s.size(); p = e + 1)
+     {
+      e = s.find(',', p);
+      if (e == std::string::npos)
+       e = s.size();
+      for (t = 0; t < T_COUNT && s.compare(p, e - p, target_name[t]); t++)
+       ;
+      if (t == T_COUNT)
+      {
+       fprintf(stderr, "i8051_fault: unknown target '%s'\n",
+               s.substr(p, e - p).c_str());
+       return 2;
+      }
+      targets[t] = true;
+     }
+    }
+    break;
+   default: usage();
+  }
+ if (optind + 1 != argc)
+  usage();
+ if (threads == 0)
+  threads = 1;
+
+ img.code = g.golden->code;
+ img.xdata = g.golden->xdata;
+ if (!i8051_load(argv[optind], &img))
+  return 2;
+ if (img.code_lo >= img.code_hi)
+ {
+  fprintf(stderr, "i8051_fault: %s holds no code\n", argv[optind]);
+  return 2;
+ }
+ g.code_lo = img.code_lo;
+ g.code_hi = img.code_hi;
+ g.golden->pc = img.entry;
+ if (!xrange && img.xdata_lo < img.xdata_hi)
+ {
+  xlo = img.xdata_lo;
+  xhi = img.xdata_hi - 1;
+ }
+ if (!run_golden(g, 1000000000ULL))
+  return 1;
+ g.hang = (unsigned long long) (g.instrs * factor) + 1000;
+ printf("golden: %llu instructions, %llu cycles, %zu checkpoints\n",
+        g.instrs, g.cycles, g.cp.size());
+
+ if (list != NULL)
+ {
+  FILE* f = fopen(list, "r");
+  char name[16];
+  injection j;
+
+  if (f == NULL)
+  {
+   fprintf(stderr, "i8051_fault: cannot open '%s'\n", list);
+   return 2;
+  }
+  while (fscanf(f, "%llu %15s %x %u", &j.cycle, name, &j.addr, &j.bit) == 4)
+  {
+   for (t = 0; t < T_COUNT && strcmp(name, target_name[t]); t++)
+    ;
+   if (t == T_COUNT)
+   {
+    fprintf(stderr, "i8051_fault: %s: unknown target '%s'\n", list, name);
+    return 2;
+   }
+   j.target = t;
+   inj.push_back(j);
+  }
+  fclose(f);
+ }
+ else
+ {
+  unsigned choice[T_COUNT], n = 0;
+
+  for (t = 0; t < T_COUNT; t++)
+   if (targets[t])
+    choice[n++] = t;
+  r.x = seed * 0x9E3779B97F4A7C15ULL | 1;
+  inj.resize(count);
+  for (injection& j: inj)
+  {
+   j.cycle = r.next() % g.cycles;
+   j.target = choice[r.next() % n];
+   j.bit = r.next() % (j.target == T_PC ? 16 : 8);
+   switch (j.target)
+   {
+    case T_IRAM:  j.addr = r.next() % 0x80; break;
+    case T_IDATA: j.addr = 0x80 + r.next() % 0x80; break;
+    case T_XDATA: j.addr = xlo + r.next() % (xhi - xlo + 1); break;
+    case T_SFR:   j.addr = 0x80 + r.next() % 0x80; break;
+    case T_PSW:   j.addr = I8051_PSW; break;
+    case T_SP:    j.addr = I8051_SP; break;
+    default:      j.addr = 0; break;
+   }
+  }
+ }
+
+ auto t0 = std::chrono::steady_clock::now();
+ for (t = 0; t < threads; t++)
+  pool.push_back(std::thread([&]() {
+   i8051_core* core = new i8051_core;
+   size_t k;
+
+   memcpy(core->code, g.golden->code, 0x10000);
+   core->is8052 = g.golden->is8052;
+   while ((k = next++) < inj.size())
+    inject(g, *core, inj[k]);
+   delete core;
+  }));
+ for (auto& th : pool)
+  th.join();
+ double secs = std::chrono::duration<double>(
+                 std::chrono::steady_clock::now() - t0).count();
+
+ for (const injection& j: inj)
+ {
+  tally[j.outcome]++;
+  early += j.early;
+ }
+ for (i = 0; i < O_COUNT; i++)
+  printf("%-7s %12llu  %6.2f%%\n", outcome_name[i], tally[i],
+         inj.empty() ? 0.0 : 100.0 * tally[i] / inj.size());
+ printf("%zu injections in %.2f s (%.0f/s, %u threads), %llu masked by "
+        "reconvergence\n", inj.size(), secs, inj.size() / secs, threads, early);
+
+ if (csv != NULL)
+ {
+  FILE* f = fopen(csv, "w");
+
+  if (f == NULL)
+  {
+   fprintf(stderr, "i8051_fault: cannot create '%s'\n", csv);
+   return 2;
+  }
+  fprintf(f, "cycle,target,addr,bit,outcome,early,instructions\n");
+  for (const injection& j: inj)
+   fprintf(f, "%llu,%s,%x,%u,%s,%d,%llu\n", j.cycle, target_name[j.target],
+           j.addr, j.bit, outcome_name[j.outcome], j.early, j.instrs);
+  fclose(f);
+ }
+ return 0;
+}
@@ -0,0 +1,524 @@
+/**
+ * @file      i8051_fuzz.cpp
+ * @author    The ArchC Team
+ *            http://www.archc.org/
+ *
+ *            Computer Systems Laboratory (LSC)
+ *            IC-UNICAMP
+ *            http://www.lsc.ic.unicamp.br/
+ *
+ * @version   1.0
+ * @date      Tue, 20 Oct 2026 09:14:52 -0300
+ *
+ * @brief     In-process firmware fuzzing on the reference core.
+ *
+ * The firmware runs on i8051_core (i8051_core.H) once up to a boot
+ * point, and that state is kept as a snapshot. Each fuzz input then
+ * restores the snapshot (IRAM, registers and only the XDATA pages
+ * written since), is fed to the firmware, and runs to a stop condition
+ * without leaving the process. The SystemC model is not used: it can
+ * be neither restored nor run at this rate.
+ *
+ * Edge coverage is recorded for every control transfer instruction
+ * (branches taken and not taken, calls, returns) as 8-bit counters
+ * indexed by a hash of source and target PC. With __AFL_SHM_ID set the
+ * counters live in that shared memory segment, otherwise they are
+ * registered as libFuzzer extra counters (or kept local).
+ *
+ *     clang++ -O2 -fsanitize=fuzzer -DI8051_FUZZ_LIBFUZZER -I.. \
+ *             -o i8051_fuzz i8051_fuzz.cpp
+ *     afl-clang-fast++ -O2 -DI8051_FUZZ_AFL -I.. -o i8051_fuzz i8051_fuzz.cpp
+ *     g++ -O2 -I.. -o i8051_fuzz i8051_fuzz.cpp
+ *
+ * The last build replays inputs: i8051_fuzz [-r repeat] file...
+ *
+ * Settings are read from the environment:
+ *
+ *     I8051_IMAGE=<file>        firmware image (required)
+ *     I8051_FUZZ_BOOT=<pc>      take the snapshot when the PC first gets
+ *                               here (default: at reset)
+ *     I8051_FUZZ_INPUT=<mode>   where the input goes:
+ *                               uart          SBUF, one byte per RI
+ *                                             (default)
+ *                               port:<n>      pins of Pn, one byte per
+ *                                             instruction reading them
+ *                               xdata:<a>[:<max>]  copied to XDATA at a
+ *                               iram:<a>[:<max>]   copied to IRAM at a
+ *     I8051_FUZZ_LEN=<addr>     xdata/iram: store the input length
+ *                               (16 bits, little endian) at this IRAM
+ *                               address
+ *     I8051_FUZZ_LIMIT=<n>      instructions per input (default 100000)
+ *     I8051_FUZZ_DRAIN=<n>      instructions run after the input is used
+ *                               up (default 1000)
+ *     I8051_FUZZ_CRASH=<pc>,... PCs that count as a crash, for example
+ *                               an assert handler
+ *
+ * A run also stops at "sjmp $". Reaching a crash PC or executing the
+ * reserved opcode aborts the process so the fuzzer records the input.
+ *
+ * @attention Copyright (C) 2002-2006 --- The ArchC Team
+ *
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <sys/shm.h>
+
+#include "i8051_core.H"
+#include "i8051_loader.H"
+#include "i8051_optable.H"
+
+#define SCON        0x98
+#define SBUF        0x99
+#define IE          0xA8
+#define SCON_RI     0x01
+#define SCON_TI     0x02
+#define IE_EA       0x80
+#define IE_ES       0x10
+
+#define FUZZ_MAP    0x10000     // coverage counters
+
+// Per-opcode actions around a step.
+#define F_BRANCH    0x01        // control transfer: record the edge
+#define F_XWRITE    0x02        // MOVX write: XDATA page becomes dirty
+#define F_SOURCE    0x04        // reads a direct or bit operand
+#define F_SBUF      0x08        // may write SBUF: transmit done
+#define F_RETI      0x10
+#define F_HALT      0x20        // SJMP, "sjmp $" when the offset is -2
+#define F_BAD       0x40        // reserved opcode
+
+// Per-PC flags.
+#define P_CRASH     0x01
+
+enum fuzz_mode { MODE_UART, MODE_PORT, MODE_XDATA, MODE_IRAM };
+
+enum fuzz_stop { STOP_HALT, STOP_LIMIT, STOP_DRAIN, STOP_CRASH };
+
+static const char* const stop_name[] = { "halt", "limit", "drain", "crash" };
+
+#ifdef I8051_FUZZ_LIBFUZZER
+__attribute__((used, section("__libfuzzer_extra_counters")))
+#endif
+static unsigned char local_map[FUZZ_MAP];
+
+struct fuzz
+{
+ i8051_core core;
+ // Snapshot
+ unsigned char iram[256], idata[256], input[4];
+ unsigned pc;
+ unsigned char xdata[0x10000];
+ bool xdirty[256];
+ std::vector<unsigned> dirty;
+ // Settings
+ unsigned mode, port, addr, max, len_addr;
+ unsigned long long limit, drain;
+ unsigned char op_flags[256];
+ unsigned char src_byte[256];   // operand byte that is read, 0 for none
+ unsigned char dst_byte[256];   // direct destination operand byte
+ bool src_bit[256];
+ unsigned char pc_flags[0x10000];
+ unsigned char* map;
+ // Current run
+ const unsigned char* data;
+ size_t size, pos;
+ bool in_isr;
+};
+
+static fuzz* fz;
+
+//! Hash of an edge into the counter map.
+static inline unsigned edge(unsigned from, unsigned to)
+{
+ return (((from << 16) | to) * 0x9E3779B1u) >> 16;
+}
+
+static unsigned long number(const char* name, const char* s)
+{
+ char* end;
+ unsigned long v = strtoul(s, &end, 0);
+
+ if (end == s || (*end != 0 && *end != ':' && *end != ','))
+ {
+  fprintf(stderr, "i8051_fuzz: bad number in %s: '%s'\n", name, s);
+  exit(2);
+ }
+ return v;
+}
+
+static void set_flags(fuzz* f)
+{
+ unsigned op, i;
+
+ for (op = 0; op < 256; op++)
+ {
+  const i8051_opinfo& o = i8051_optable[op];
+  unsigned char fl = 0;
+
+  f->src_byte[op] = 0;
+  f->dst_byte[op] = 0;
+  f->src_bit[op] = false;
+  if (o.mnemonic == NULL)
+  {
+   f->op_flags[op] = F_BAD;
+   continue;
+  }
+  if (strcmp(o.mnemonic, "ret") == 0)
+   fl |= F_BRANCH;
+  if (strcmp(o.mnemonic, "reti") == 0)
+   fl |= F_BRANCH | F_RETI;
+  if (op == 0x80)
+   fl |= F_HALT;
+  if (op == 0xF0 || op == 0xF2 || op == 0xF3)
+   fl |= F_XWRITE;
+  for (i = 0; i < o.nopd; i++)
+   switch (o.opd[i].kind)
+   {
+    case I8051_OPD_REL: case I8051_OPD_ADDR11: case I8051_OPD_ADDR16:
+    case I8051_OPD_CODE_DPTR:
+     fl |= F_BRANCH;
+     break;
+    case I8051_OPD_DIR: case I8051_OPD_BIT: case I8051_OPD_NBIT:
+     // Operand 0 is a destination, except where the instruction only
+     // tests or pushes it.
+     if (i > 0 || strcmp(o.mnemonic, "jb") == 0 ||
+         strcmp(o.mnemonic, "jnb") == 0 || strcmp(o.mnemonic, "push") == 0)
+     {
+      fl |= F_SOURCE;
+      f->src_byte[op] = o.opd[i].byte;
+      f->src_bit[op] = o.opd[i].kind != I8051_OPD_DIR;
+     }
+     else if (o.opd[i].kind == I8051_OPD_DIR)
+     {
+      fl |= F_SBUF;
+      f->dst_byte[op] = o.opd[i].byte;
+     }
+     break;
+   }
+  f->op_flags[op] = fl;
+ }
+}
+
+static void configure(fuzz* f)
+{
+ const char* s;
+ i8051_image img;
+ unsigned long long n;
+
+ f->mode = MODE_UART;
+ f->len_addr = 0x100;
+ f->limit = 100000;
+ f->drain = 1000;
+ memset(f->pc_flags, 0, sizeof(f->pc_flags));
+ if ((s = getenv("I8051_FUZZ_INPUT")) != NULL)
+ {
+  if (strcmp(s, "uart") == 0)
+   f->mode = MODE_UART;
+  else if (strncmp(s, "port:", 5) == 0)
+  {
+   f->mode = MODE_PORT;
+   f->port = number("I8051_FUZZ_INPUT", s + 5) & 3;
+  }
+  else if (strncmp(s, "xdata:", 6) == 0 || strncmp(s, "iram:", 5) == 0)
+  {
+   f->mode = s[0] == 'x' ? MODE_XDATA : MODE_IRAM;
+   s = strchr(s, ':') + 1;
+   n = number("I8051_FUZZ_INPUT", s);
+   if (n >= (f->mode == MODE_XDATA ? 0x10000 : 0x100))
+   {
+    fprintf(stderr, "i8051_fuzz: I8051_FUZZ_INPUT address %llx outside "
+                    "the space\n", n);
+    exit(2);
+   }
+   f->addr = n;
+   f->max = (f->mode == MODE_XDATA ? 0x10000 : 0x100) - f->addr;
+   if ((s = strchr(s, ':')) != NULL &&
+       number("I8051_FUZZ_INPUT", s + 1) < f->max)
+    f->max = number("I8051_FUZZ_INPUT", s + 1);
+  }
+  else
+  {
+   fprintf(stderr, "i8051_fuzz: unknown I8051_FUZZ_INPUT '%s'\n", s);
+   exit(2);
+  }
+ }
+ if ((s = getenv("I8051_FUZZ_LEN")) != NULL)
+  f->len_addr = number("I8051_FUZZ_LEN", s) & 0xFF;
+ if ((s = getenv("I8051_FUZZ_LIMIT")) != NULL)
+  f->limit = number("I8051_FUZZ_LIMIT", s);
+ if ((s = getenv("I8051_FUZZ_DRAIN")) != NULL)
+  f->drain = number("I8051_FUZZ_DRAIN", s);
+ for (s = getenv("I8051_FUZZ_CRASH"); s != NULL && *s; )
+ {
+  f->pc_flags[number("I8051_FUZZ_CRASH", s) & 0xFFFF] |= P_CRASH;
+  if ((s = strchr(s, ',')) != NULL)
+   s++;
+ }
+ set_flags(f);
+
+ if ((s = getenv("__AFL_SHM_ID")) != NULL)
+ {
+  f->map = (unsigned char*) shmat(atoi(s), NULL, 0);
+  if (f->map == (unsigned char*) -1)
+  {
+   fprintf(stderr, "i8051_fuzz: cannot attach coverage map %s\n", s);
+   exit(2);
+  }
+ }
+ else
+  f->map = local_map;
+
+ if ((s = getenv("I8051_IMAGE")) == NULL)
+ {
+  fprintf(stderr, "i8051_fuzz: I8051_IMAGE is not set\n");
+  exit(2);
+ }
+ img.code = f->core.code;
+ img.xdata = f->core.xdata;
+ if (!i8051_load(s, &img))
+  exit(2);
+ f->core.pc = img.entry;
+
+ // Boot, then snapshot.
+ if ((s = getenv("I8051_FUZZ_BOOT")) != NULL)
+ {
+  unsigned boot = number("I8051_FUZZ_BOOT", s) & 0xFFFF;
+
+  for (n = 0; f->core.pc != boot; n++)
+   if (n == 100000000ULL)
+   {
+    fprintf(stderr, "i8051_fuzz: boot PC %04x not reached\n", boot);
+    exit(2);
+   }
+   else
+    f->core.step();
+ }
+ memcpy(f->iram, f->core.iram, 256);
+ memcpy(f->idata, f->core.idata, 256);
+ memcpy(f->input, f->core.input, 4);
+ memcpy(f->xdata, f->core.xdata, 0x10000);
+ f->pc = f->core.pc;
+ memset(f->xdirty, 0, sizeof(f->xdirty));
+}
+
+static inline void mark_dirty(fuzz* f, unsigned a)
+{
+ if (!f->xdirty[a >> 8])
+ {
+  f->xdirty[a >> 8] = true;
+  f->dirty.push_back(a >> 8);
+ }
+}
+
+static void restore(fuzz* f)
+{
+ i8051_core& c = f->core;
+
+ memcpy(c.iram, f->iram, 256);
+ memcpy(c.idata, f->idata, 256);
+ memcpy(c.input, f->input, 4);
+ for (unsigned p: f->dirty)
+ {
+  memcpy(c.xdata + (p << 8), f->xdata + (p << 8), 256);
+  f->xdirty[p] = false;
+ }
+ f->dirty.clear();
+ c.pc = f->pc;
+ c.cycles = 0;
+ c.instrs = 0;
+ f->in_isr = false;
+}
+
+//! Place a buffer input before the run.
+static void inject(fuzz* f)
+{
+ i8051_core& c = f->core;
+ size_t n = f->size < f->max ? f->size : f->max, i;
+
+ if (f->mode == MODE_XDATA)
+ {
+  memcpy(c.xdata + f->addr, f->data, n);
+  for (i = 0; i < n; i += 256)
+   mark_dirty(f, f->addr + i);
+  if (n)
+   mark_dirty(f, f->addr + n - 1);
+ }
+ else
+  memcpy(c.iram + f->addr, f->data, n);
+ if (f->len_addr < 0x100)
+ {
+  c.iram[f->len_addr] = n & 0xFF;
+  c.iram[(f->len_addr + 1) & 0xFF] = n >> 8;
+ }
+}
+
+//! Serial port: the next byte arrives as soon as RI is clear.
+static inline void uart(fuzz* f)
+{
+ i8051_core& c = f->core;
+
+ if (c.iram[SCON] & SCON_RI || f->pos >= f->size)
+  return;
+ c.iram[SBUF] = f->data[f->pos++];
+ c.iram[SCON] |= SCON_RI;
+ if ((c.iram[IE] & (IE_EA | IE_ES)) == (IE_EA | IE_ES) && !f->in_isr)
+ {
+  c.interrupt(0x23);
+  f->in_isr = true;
+ }
+}
+
+//! Run one input from the snapshot.
+static unsigned run(fuzz* f, const unsigned char* data, size_t size)
+{
+ i8051_core& c = f->core;
+ unsigned long long n, end = f->limit;
+ unsigned char* map = f->map;
+ bool stream = f->mode == MODE_UART || f->mode == MODE_PORT;
+
+ restore(f);
+ f->data = data;
+ f->size = size;
+ f->pos = 0;
+ if (!stream)
+  inject(f);
+ for (n = 0; n < end; n++)
+ {
+  unsigned pc, op, fl, a;
+
+  if (f->mode == MODE_UART)
+   uart(f);
+  pc = c.pc;
+  op = c.code[pc];
+  fl = f->op_flags[op];
+  if (f->pc_flags[pc] & P_CRASH)
+   return STOP_CRASH;
+  if (fl)
+  {
+   if (fl & F_BAD)
+    return STOP_CRASH;
+   if ((fl & F_HALT) && c.code[(pc + 1) & 0xFFFF] == 0xFE)
+    return STOP_HALT;
+   if (fl & F_XWRITE)
+    mark_dirty(f, op == 0xF0 ? c.dptr() :
+                  (c.iram[I8051_P2] << 8) |
+                  c.iram[(c.iram[I8051_PSW] & 0x18) | (op & 1)]);
+   if ((fl & F_SOURCE) && f->mode == MODE_PORT)
+   {
+    a = c.code[(pc + f->src_byte[op]) & 0xFFFF];
+    if (f->src_bit[op])
+     a = a < 0x80 ? 0 : a & 0xF8;
+    if (a == 0x80 + 0x10 * f->port && f->pos < f->size)
+     c.input[f->port] = f->data[f->pos++];
+   }
+   if ((fl & F_SBUF) && c.code[(pc + f->dst_byte[op]) & 0xFFFF] == SBUF)
+    c.iram[SCON] |= SCON_TI;
+   if (fl & F_RETI)
+    f->in_isr = false;
+  }
+  c.step();
+  if (fl & F_BRANCH)
+   map[edge(pc, c.pc)]++;
+  if (stream && f->pos >= f->size && end == f->limit && n + f->drain < end)
+   end = n + f->drain;
+ }
+ return n >= f->limit ? STOP_LIMIT : STOP_DRAIN;
+}
+
+static void init()
+{
+ fz = new fuzz;
+ configure(fz);
+}
+
+#if defined(I8051_FUZZ_LIBFUZZER)
+
+extern "C" int LLVMFuzzerInitialize(int* argc, char*** argv)
+{
+ (void) argc;
+ (void) argv;
+ init();
+ return 0;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const unsigned char* data, size_t size)
+{
+ if (run(fz, data, size) == STOP_CRASH)
+ {
+  fprintf(stderr, "i8051_fuzz: crash at pc %04x\n", fz->core.pc);
+  abort();
+ }
+ return 0;
+}
+
+#elif defined(I8051_FUZZ_AFL)
+
+__AFL_FUZZ_INIT();
+
+int main()
+{
+ init();
+ __AFL_INIT();
+ unsigned char* buf = __AFL_FUZZ_TESTCASE_BUF;
+
+ while (__AFL_LOOP(1000000))
+  if (run(fz, buf, __AFL_FUZZ_TESTCASE_LEN) == STOP_CRASH)
+   abort();
+ return 0;
+}
+
+#else
+
+//! Replay: run each file, report how it stopped and the edges it hit.
+int main(int argc, char** argv)
+{
+ unsigned long repeat = 1, r;
+ unsigned long long runs = 0;
+ std::vector<unsigned char> data;
+ unsigned stop = STOP_HALT, i;
+ int a = 1, edges;
+
+ if (argc > 2 && strcmp(argv[1], "-r") == 0)
+ {
+  repeat = number("-r", argv[2]);
+  a = 3;
+ }
+ if (a >= argc)
+ {
+  fprintf(stderr, "usage: i8051_fuzz [-r repeat] file...\n");
+  return 2;
+ }
+ init();
+ auto start = std::chrono::steady_clock::now();
+ for (; a < argc; a++)
+ {
+  FILE* f = fopen(argv[a], "rb");
+  int ch;
+
+  if (f == NULL)
+  {
+   fprintf(stderr, "i8051_fuzz: cannot open '%s'\n", argv[a]);
+   return 2;
+  }
+  data.clear();
+  while ((ch = getc(f)) != EOF)
+   data.push_back(ch);
+  fclose(f);
+  memset(fz->map, 0, FUZZ_MAP);
+  for (r = 0; r < repeat; r++, runs++)
+   stop = run(fz, data.data(), data.size());
+  for (i = 0, edges = 0; i < FUZZ_MAP; i++)
+   edges += fz->map[i] != 0;
+  printf("%s: %s at pc %04x after %llu instructions, %d edges\n", argv[a],
+         stop_name[stop], fz->core.pc, fz->core.instrs, edges);
+ }
+ double secs = std::chrono::duration<double>(
+                 std::chrono::steady_clock::now() - start).count();
+ printf("%llu runs, %.0f runs/s\n", runs, runs / secs);
+ return stop == STOP_CRASH;
+}
+
+#endif
@@ -0,0 +1,419 @@
+/**
+ * @file      i8051_net.cpp
+ * @author    The ArchC Team
+ *            http://www.archc.org/
+ *
+ *            Computer Systems Laboratory (LSC)
+ *            IC-UNICAMP
+ *            http://www.lsc.ic.unicamp.br/
+ *
+ * @version   1.0
+ * @date      Fri, 23 Oct 2026 15:40:12 -0300
+ *
+ * @brief     Several 8051 nodes on a shared serial bus, run in parallel.
+ *
+ * Every node is a reference core (i8051_core.H) with a serial port; the
+ * ports share one half-duplex bus, as RS-485 transceivers do. A frame
+ * written to SBUF is on the bus for its length in bit times and reaches
+ * the other nodes at its end, where it sets RI, unless:
+ *
+ *     REN is clear, or the receiver is in mode 0   not received
+ *     RI is still set                              overrun: lost
+ *     mode 2/3, SM2 set and the 9th bit clear      address filter
+ *
+ * Modes 1 (10 bits) and 2/3 (11 bits, TB8/RB8 as 9th bit) go on the bus;
+ * mode 0 only sets TI after 8 bit times. There are no timers in the
+ * core, so the bit time is an option, the same for all modes. The first
+ * frame to start holds the bus; a frame that starts while it is busy is
+ * a collision, counted and dropped. The serial interrupt (vector 0x23)
+ * is taken when EA and ES are set and RI or TI is, outside another
+ * handler.
+ *
+ * Nodes are spread over threads and synchronized conservatively: no
+ * frame is shorter than 10 bit times, so a frame that starts in a
+ * window of that length ends after it, and the nodes run each window
+ * without seeing each other. After a barrier every thread merges the
+ * frames of the last window, which are in per-node buffers used on
+ * alternate windows, into the inboxes of its own nodes. The result
+ * does not depend on the thread count. A node idle in "sjmp $" skips to
+ * its next event, and the run ends when all are idle with nothing on
+ * the bus, or at the cycle limit.
+ *
+ *     g++ -O2 -pthread -I.. -o i8051_net i8051_net.cpp
+ *     ./i8051_net [options] image...
+ *
+ *     -n <nodes>     node count (default: one per image); images are
+ *                    assigned in order, the last one repeated
+ *     -a <addr>      store the node number at this IRAM address
+ *     -b <cycles>    machine cycles per bit (default 96: 9600 baud at
+ *                    11.0592 MHz)
+ *     -c <cycles>    cycle limit (default 100000000)
+ *     -l <file>      log every frame: cycle, node, data, collision
+ *     -j <threads>   -8 (8052 upper bank)
+ *
+ * @attention Copyright (C) 2002-2006 --- The ArchC Team
+ *
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+#include "i8051_core.H"
+#include "i8051_loader.H"
+#include "i8051_optable.H"
+
+#define SCON        0x98
+#define SBUF        0x99
+#define IE          0xA8
+#define SCON_SM2    0x20
+#define SCON_REN    0x10
+#define SCON_TB8    0x08
+#define SCON_RB8    0x04
+#define SCON_TI     0x02
+#define SCON_RI     0x01
+#define IE_EA       0x80
+#define IE_ES       0x10
+
+#define NEVER       (~0ULL)
+
+struct frame
+{
+ unsigned long long start, end;
+ unsigned node;
+ unsigned data;                 // 9 bits in modes 2/3
+};
+
+struct node
+{
+ i8051_core core;
+ unsigned id;
+ std::vector<frame> out[2];     // sent, by window parity
+ std::deque<frame> in;          // to receive, in end order
+ unsigned long long ti_at;
+ bool in_isr;
+ bool quiet[2];                 // idle at the end, by window parity
+ unsigned long long tx, rx, overrun, filtered;
+};
+
+struct net
+{
+ std::vector<node*> nodes;
+ unsigned long long bit, quantum, limit;
+ unsigned threads;
+ FILE* log;
+ unsigned char sbuf_byte[256];  // operand byte of a direct destination
+ // Barrier
+ std::atomic<unsigned> arrived;
+ std::atomic<unsigned> phase;
+ // Results of thread 0's merge
+ unsigned long long frames, collisions, end;
+};
+
+//! Opcodes that may write a direct address: where its operand byte is.
+static void scan_opcodes(net& g)
+{
+ unsigned op, k;
+
+ memset(g.sbuf_byte, 0, sizeof(g.sbuf_byte));
+ for (op = 0; op < 256; op++)
+ {
+  const i8051_opinfo& o = i8051_optable[op];
+
+  if (o.mnemonic == NULL || strcmp(o.mnemonic, "push") == 0)
+   continue;
+  for (k = 0; k < o.nopd; k++)
+   if (o.opd[k].kind == I8051_OPD_DIR &&
+       (k == 0 || strcmp(o.mnemonic, "xch") == 0))
+    g.sbuf_byte[op] = o.opd[k].byte;
+ }
+}
+
+static void barrier(net& g)
+{
+ unsigned p = g.phase.load();
+
+ if (g.arrived.fetch_add(1) + 1 == g.threads)
+ {
+  g.arrived.store(0);
+  g.phase.store(p + 1);
+ }
+ else
+  while (g.phase.load() == p)
+   std::this_thread::yield();
+}
+
+static void receive(node& n, const frame& f)
+{
+ unsigned char* iram = n.core.iram;
+ unsigned mode = iram[SCON] >> 6;
+ unsigned rb8 = mode >= 2 ? (f.data >> 8) & 1 : 1;
+
+ if (mode == 0 || !(iram[SCON] & SCON_REN))
+  return;
+ if (iram[SCON] & SCON_RI)
+ {
+  n.overrun++;
+  return;
+ }
+ if (mode >= 2 && (iram[SCON] & SCON_SM2) && !rb8)
+ {
+  n.filtered++;
+  return;
+ }
+ iram[SBUF] = f.data & 0xFF;
+ iram[SCON] = (iram[SCON] & ~SCON_RB8) | (rb8 ? SCON_RB8 : 0) | SCON_RI;
+ n.rx++;
+}
+
+//! SBUF was written by the instruction that started at start.
+static void transmit(net& g, node& n, unsigned long long start, unsigned w)
+{
+ unsigned char* iram = n.core.iram;
+ unsigned mode = iram[SCON] >> 6;
+ frame f;
+
+ if (mode == 0)
+ {
+  n.ti_at = start + 8 * g.bit;
+  return;
+ }
+ f.start = start;
+ f.end = start + (mode == 1 ? 10 : 11) * g.bit;
+ f.node = n.id;
+ f.data = iram[SBUF];
+ if (mode >= 2 && (iram[SCON] & SCON_TB8))
+  f.data |= 0x100;
+ n.out[w & 1].push_back(f);
+ n.ti_at = f.end;
+ n.tx++;
+}
+
+//! "sjmp $" at the PC.
+static inline bool op_halt(const i8051_core& c)
+{
+ return c.code[c.pc] == 0x80 && c.code[(c.pc + 1) & 0xFFFF] == 0xFE;
+}
+
+//! Run a node up to the end of window w.
+static void run(net& g, node& n, unsigned long long until, unsigned w)
+{
+ i8051_core& c = n.core;
+
+ n.out[w & 1].clear();
+ while (c.cycles < until)
+ {
+  unsigned long long now = c.cycles;
+  unsigned op = c.code[c.pc];
+
+  if (n.ti_at <= now)
+  {
+   c.iram[SCON] |= SCON_TI;
+   n.ti_at = NEVER;
+  }
+  while (!n.in.empty() && n.in.front().end <= now)
+  {
+   receive(n, n.in.front());
+   n.in.pop_front();
+  }
+  if (!n.in_isr && (c.iram[IE] & (IE_EA | IE_ES)) == (IE_EA | IE_ES) &&
+      (c.iram[SCON] & (SCON_RI | SCON_TI)))
+  {
+   c.interrupt(0x23);
+   n.in_isr = true;
+   continue;
+  }
+  if (op_halt(c))
+  {
+   // sjmp $: nothing changes before the next event
+   unsigned long long next = std::min(until, n.ti_at);
+
+   if (!n.in.empty())
+    next = std::min(next, n.in.front().end);
+   c.instrs += (next - now + 1) / 2;
+   c.cycles = next;
+   continue;
+  }
+  if (op == 0x32)
+   n.in_isr = false;
+  if (g.sbuf_byte[op] && c.code[(c.pc + g.sbuf_byte[op]) & 0xFFFF] == SBUF)
+  {
+   c.step();
+   transmit(g, n, now, w);
+  }
+  else
+   c.step();
+ }
+ n.quiet[w & 1] = op_halt(c) && n.ti_at == NEVER && n.in.empty() &&
+                  n.out[w & 1].empty();
+}
+
+//! Put the frames of window w on the bus, for the nodes [first, ...)
+//! taken every step. Every thread computes the same bus.
+static void merge(net& g, std::vector<frame>& bus, unsigned long long& busy,
+                  unsigned w, unsigned first, unsigned step, bool report)
+{
+ bus.clear();
+ for (node* n: g.nodes)
+  bus.insert(bus.end(), n->out[w & 1].begin(), n->out[w & 1].end());
+ std::sort(bus.begin(), bus.end(), [](const frame& a, const frame& b) {
+  return a.start != b.start ? a.start < b.start : a.node < b.node;
+ });
+ for (const frame& f: bus)
+ {
+  bool lost = f.start < busy;
+
+  if (report)
+  {
+   g.frames++;
+   g.collisions += lost;
+   if (g.log != NULL)
+    fprintf(g.log, "%llu %u %03x%s\n", f.start, f.node, f.data,
+            lost ? " collision" : "");
+  }
+  if (lost)
+   continue;
+  busy = f.end;
+  for (unsigned k = first; k < g.nodes.size(); k += step)
+   if (k != f.node)
+    g.nodes[k]->in.push_back(f);
+ }
+}
+
+static void worker(net& g, unsigned t)
+{
+ std::vector<frame> bus;
+ unsigned long long busy = 0, until;
+ unsigned w, k;
+
+ for (w = 0, until = g.quantum; ; w++, until += g.quantum)
+ {
+  if (w > 0)
+   merge(g, bus, busy, w - 1, t, g.threads, t == 0);
+  for (k = t; k < g.nodes.size(); k += g.threads)
+   run(g, *g.nodes[k], until, w);
+  barrier(g);
+  bool quiet = true;
+
+  for (node* n: g.nodes)
+   quiet = quiet && n->quiet[w & 1];
+  if (quiet || until >= g.limit)
+  {
+   if (t == 0)
+   {
+    merge(g, bus, busy, w, g.nodes.size(), 1, true);
+    g.end = until;
+   }
+   return;
+  }
+ }
+}
+
+static void usage()
+{
+ fprintf(stderr, "usage: i8051_net [-n nodes] [-a addr] [-b cycles] "
+                 "[-c cycles] [-l file]\n"
+                 "                 [-j threads] [-8] image...\n");
+ exit(2);
+}
+
+int main(int argc, char** argv)
+{
+ net g;
+ std::vector<std::thread> pool;
+ unsigned long long instrs = 0;
+ unsigned nodes = 0, addr = 0x100, t, k;
+ const char* log = NULL;
+ bool is8052 = false;
+ int c;
+
+ g.bit = 96;
+ g.limit = 100000000ULL;
+ g.threads = std::thread::hardware_concurrency();
+ while ((c = getopt(argc, argv, "n:a:b:c:l:j:8")) != -1)
+  switch (c)
+  {
+   case 'n': nodes = atoi(optarg); break;
+   case 'a': addr = strtoul(optarg, NULL, 16); break;
+   case 'b': g.bit = strtoull(optarg, NULL, 0); break;
+   case 'c': g.limit = strtoull(optarg, NULL, 0); break;
+   case 'l': log = optarg; break;
+   case 'j': g.threads = atoi(optarg); break;
+   case '8': is8052 = true; break;
+   default: usage();
+  }
+ if (optind >= argc || g.bit == 0 || addr > 0x100)
+  usage();
+ if (nodes == 0)
+  nodes = argc - optind;
+ if (g.threads == 0)
+  g.threads = 1;
+ if (g.threads > nodes)
+  g.threads = nodes;
+ g.quantum = 10 * g.bit;
+ scan_opcodes(g);
+
+ for (k = 0; k < nodes; k++)
+ {
+  node* n = new node;
+  unsigned a = std::min((unsigned) (optind + k), (unsigned) argc - 1);
+  i8051_image img;
+
+  memset(&img, 0, sizeof(img));
+  img.code = n->core.code;
+  img.xdata = n->core.xdata;
+  if (!i8051_load(argv[a], &img))
+   return 2;
+  n->core.is8052 = is8052;
+  n->core.pc = img.entry;
+  if (addr < 0x100)
+   n->core.iram[addr] = k;
+  n->id = k;
+  n->ti_at = NEVER;
+  n->in_isr = false;
+  n->quiet[0] = n->quiet[1] = false;
+  n->tx = n->rx = n->overrun = n->filtered = 0;
+  g.nodes.push_back(n);
+ }
+ g.log = NULL;
+ if (log != NULL && (g.log = fopen(log, "w")) == NULL)
+ {
+  fprintf(stderr, "i8051_net: cannot create '%s'\n", log);
+  return 2;
+ }
+ g.arrived = 0;
+ g.phase = 0;
+ g.frames = g.collisions = 0;
+
+ auto t0 = std::chrono::steady_clock::now();
+ for (t = 0; t < g.threads; t++)
+  pool.push_back(std::thread(worker, std::ref(g), t));
+ for (auto& th : pool)
+  th.join();
+ double secs = std::chrono::duration<double>(
+                 std::chrono::steady_clock::now() - t0).count();
+
+ for (node* n: g.nodes)
+ {
+  printf("node %2u: %12llu instructions, %12llu cycles, tx %llu, rx %llu, "
+         "overrun %llu, filtered %llu\n", n->id, n->core.instrs,
+         n->core.cycles, n->tx, n->rx, n->overrun, n->filtered);
+  instrs += n->core.instrs;
+ }
+ printf("%llu cycles, %llu frames, %llu collisions in %.2f s "
+        "(%.1f MIPS, %u threads)\n", g.end, g.frames, g.collisions, secs,
+        instrs / secs / 1e6, g.threads);
+ if (g.log != NULL)
+  fclose(g.log);
+ for (node* n: g.nodes)
+  delete n;
+ return 0;
+}
@@ -0,0 +1,590 @@
+/**
+ * @file      i8051_optest.cpp
+ * @author    The ArchC Team
+ *            http://www.archc.org/
+ *
+ *            Computer Systems Laboratory (LSC)
+ *            IC-UNICAMP
+ *            http://www.lsc.ic.unicamp.br/
+ *
+ * @version   1.0
+ * @date      Mon, 19 Oct 2026 18:05:37 -0300
+ *
+ * @brief     Single instruction state-space tester for all opcodes.
+ *
+ * Every opcode of i8051_isa.ac is executed by each engine listed in
+ * engines[] and by the table-driven spec (i8051_spec.H) from the same
+ * state, and the results are compared bit for bit: the direct space,
+ * the 8052 upper bank, PC, cycle count and the XDATA bytes an
+ * instruction may write. ALU opcodes are run over every combination of
+ * A, the second operand and CY (DA: A, CY and AC; MUL/DIV: A and B);
+ * all opcodes then get random states. Opcodes are spread over threads.
+ *
+ *     g++ -O2 -pthread -I.. -o i8051_optest i8051_optest.cpp
+ *     ./i8051_optest [-j threads] [-n random cases] [-s seed]
+ *
+ * The ArchC behaviors are checked through the lockstep reference
+ * (i8051_cosim.H): "-i dir" writes one Intel HEX test program per
+ * opcode, each setting up random states and executing the opcode, to be
+ * run with I8051_COSIM=1. Since the reference core is checked against
+ * the spec here, the model is checked against the spec transitively.
+ *
+ * @attention Copyright (C) 2002-2006 --- The ArchC Team
+ *
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+#include "i8051_core.H"
+#include "i8051_optable.H"
+#include "i8051_spec.H"
+
+//! An engine executes the instruction at c.pc on the state in c.
+struct engine
+{
+ const char* name;
+ void (*step)(i8051_core& c);
+};
+
+static void core_step(i8051_core& c)
+{
+ c.step();
+}
+
+static const engine engines[] = {
+ { "core", core_step },
+};
+
+#define NENGINES (sizeof(engines) / sizeof(engines[0]))
+
+struct rng
+{
+ unsigned long long x;
+
+ unsigned next()
+ {
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  return (unsigned) (x >> 16);
+ }
+
+ unsigned byte() { return next() & 0xFF; }
+
+ void fill(unsigned char* p, unsigned n)
+ {
+  for (unsigned i = 0; i < n; i += 8)
+  {
+   x ^= x << 13;
+   x ^= x >> 7;
+   x ^= x << 17;
+   memcpy(p + i, &x, 8);
+  }
+ }
+};
+
+struct result
+{
+ unsigned long long cases;
+ unsigned long long failures;
+ std::string first;             // report of the first failing case
+};
+
+//! Per-thread machines: the engine under test and the spec.
+struct bench
+{
+ i8051_core* dut;
+ i8051_core* ref;
+ rng r;
+
+ bench(unsigned long long seed)
+ {
+  dut = new i8051_core;
+  ref = new i8051_core;
+  r.x = seed * 0x9E3779B97F4A7C15ULL | 1;
+  for (unsigned i = 0; i < 0x10000; i++)
+  {
+   dut->code[i] = ref->code[i] = r.byte();
+   dut->xdata[i] = ref->xdata[i] = r.byte();
+  }
+ }
+
+ ~bench()
+ {
+  delete dut;
+  delete ref;
+ }
+};
+
+//! XDATA addresses an instruction at state c may write.
+static void xdata_targets(const i8051_core& c, unsigned* x)
+{
+ unsigned bank = c.iram[I8051_PSW] & 0x18;
+
+ x[0] = c.dptr();
+ x[1] = (c.iram[I8051_P2] << 8) | c.iram[bank];
+ x[2] = (c.iram[I8051_P2] << 8) | c.iram[bank + 1];
+}
+
+//! Random state around opcode op at a random PC.
+static void random_state(bench& t, unsigned op)
+{
+ i8051_core& c = *t.ref;
+ t.r.fill(c.iram, 256);
+ t.r.fill(c.idata, 256);
+ c.input[0] = t.r.byte();
+ c.input[1] = t.r.byte();
+ c.input[2] = t.r.byte();
+ c.input[3] = t.r.byte();
+ c.is8052 = t.r.next() & 1;
+ c.pc = t.r.next() & 0xFFFF;
+ c.code[c.pc] = op;
+ c.code[(c.pc + 1) & 0xFFFF] = t.r.byte();
+ c.code[(c.pc + 2) & 0xFFFF] = t.r.byte();
+}
+
+//! Storage of operand i of op in state c, NULL for non-byte operands.
+static unsigned char* operand(i8051_core& c, unsigned op, unsigned i)
+{
+ const i8051_operand& o = i8051_optable[op].opd[i];
+ unsigned bank = c.iram[I8051_PSW] & 0x18, a;
+
+ switch (o.kind)
+ {
+  case I8051_OPD_A:
+   return &c.iram[I8051_ACC];
+  case I8051_OPD_IMM:
+   return &c.code[(c.pc + o.byte) & 0xFFFF];
+  case I8051_OPD_REG:
+   return &c.iram[bank | (op & 7)];
+  case I8051_OPD_IND:
+   a = c.iram[bank | (op & 1)];
+   return (a & 0x80) && c.is8052 ? &c.idata[a] : &c.iram[a];
+  case I8051_OPD_DIR:
+   return &c.iram[c.code[(c.pc + o.byte) & 0xFFFF]];
+ }
+ return NULL;
+}
+
+
+//! m is one of the blank separated words in list.
+static bool is(const char* m, const char* list)
+{
+ const char* p;
+ size_t n = strlen(m);
+
+ for (p = strstr(list, m); p != NULL; p = strstr(p + 1, m))
+  if ((p == list || p[-1] == ' ') && (p[n] == ' ' || p[n] == 0))
+   return true;
+ return false;
+}
+
+static bool is_byte(unsigned kind)
+{
+ return kind == I8051_OPD_A || kind == I8051_OPD_IMM ||
+        kind == I8051_OPD_REG || kind == I8051_OPD_IND ||
+        kind == I8051_OPD_DIR;
+}
+
+//! Exhaustive cases of op, 0 for random states only:
+//!   binary ALU: CY = k bit 0, operand 1 = k bits 1-8, operand 0 = k >> 9
+//!   MUL, DIV:   A = k bits 0-7, B = k >> 8
+//!   DA:         A = k bits 0-7, CY = k bit 8, AC = k bit 9
+//!   unary A:    CY = k bit 0, A = k >> 1
+static unsigned exhaustive(unsigned op)
+{
+ const i8051_opinfo& o = i8051_optable[op];
+
+ if (o.mnemonic == NULL)
+  return 0;
+ if (is(o.mnemonic, "add addc subb anl orl xrl cjne") &&
+     is_byte(o.opd[0].kind) && is_byte(o.opd[1].kind))
+  return 256 * 256 * 2;
+ if (is(o.mnemonic, "mul div"))
+  return 256 * 256;
+ if (is(o.mnemonic, "da"))
+  return 256 * 4;
+ if (o.nopd == 1 && o.opd[0].kind == I8051_OPD_A)
+  return 256 * 2;
+ return 0;
+}
+
+static void set_exhaustive(i8051_core& c, unsigned op, unsigned n, unsigned k)
+{
+ unsigned char* psw = &c.iram[I8051_PSW];
+
+ switch (n)
+ {
+  case 256 * 256 * 2:
+   *psw = (*psw & 0x7F) | (k & 1) << 7;
+   *operand(c, op, 1) = k >> 1;
+   *operand(c, op, 0) = k >> 9;
+   break;
+  case 256 * 256:
+   c.iram[I8051_ACC] = k;
+   c.iram[I8051_B] = k >> 8;
+   break;
+  case 256 * 4:
+   *psw = (*psw & 0x3F) | (k >> 8 & 1) << 7 | (k >> 9) << 6;
+   c.iram[I8051_ACC] = k;
+   break;
+  default:
+   *psw = (*psw & 0x7F) | (k & 1) << 7;
+   c.iram[I8051_ACC] = k >> 1;
+   break;
+ }
+}
+
+static void print_state(std::string& out, const char* label,
+                        const unsigned char* iram, unsigned pc,
+                        unsigned long long cycles)
+{
+ char buf[160];
+
+ snprintf(buf, sizeof(buf), "    %-5s pc %04x A %02x B %02x PSW %02x SP %02x "
+          "DPTR %02x%02x cycles %llu\n", label, pc, iram[I8051_ACC],
+          iram[I8051_B], iram[I8051_PSW], iram[I8051_SP], iram[I8051_DPH],
+          iram[I8051_DPL], cycles);
+ out += buf;
+}
+
+//! Run the case set up in t.ref on every engine and on the spec; false
+//! on a mismatch, described in out.
+static bool run_case(bench& t, std::string& out)
+{
+ i8051_core& ref = *t.ref;
+ i8051_core& dut = *t.dut;
+ unsigned x[3], pc = ref.pc, i, e;
+ unsigned char code[3], xsave[3], in[256];
+ bool ok = true;
+
+ for (i = 0; i < 3; i++)
+  code[i] = ref.code[(pc + i) & 0xFFFF];
+ xdata_targets(ref, x);
+ for (i = 0; i < 3; i++)
+  xsave[i] = ref.xdata[x[i]];
+ for (e = 0; e < NENGINES; e++)
+ {
+  memcpy(dut.iram, ref.iram, 256);
+  memcpy(dut.idata, ref.idata, 256);
+  memcpy(dut.input, ref.input, 4);
+  for (i = 0; i < 3; i++)
+  {
+   dut.code[(pc + i) & 0xFFFF] = code[i];
+   dut.xdata[x[i]] = xsave[i];
+  }
+  dut.pc = pc;
+  dut.is8052 = ref.is8052;
+  dut.cycles = 0;
+  if (e == 0)
+  {
+   // The spec runs once, after its input state was copied out.
+   memcpy(in, ref.iram, 256);
+   ref.cycles = 0;
+   i8051_spec(ref).step();
+  }
+  engines[e].step(dut);
+  if (dut.pc == ref.pc && dut.cycles == ref.cycles &&
+      memcmp(dut.iram, ref.iram, 256) == 0 &&
+      memcmp(dut.idata + 0x80, ref.idata + 0x80, 0x80) == 0 &&
+      dut.xdata[x[0]] == ref.xdata[x[0]] &&
+      dut.xdata[x[1]] == ref.xdata[x[1]] &&
+      dut.xdata[x[2]] == ref.xdata[x[2]])
+   continue;
+  if (ok)
+  {
+   char buf[80];
+
+   snprintf(buf, sizeof(buf), "    code  %02x %02x %02x\n", code[0], code[1],
+            code[2]);
+   out = buf;
+   print_state(out, "in", in, pc, 0);
+   print_state(out, "spec", ref.iram, ref.pc, ref.cycles);
+  }
+  ok = false;
+  out += std::string("    engine ") + engines[e].name + ":\n";
+  print_state(out, "got", dut.iram, dut.pc, dut.cycles);
+  for (i = 0; i < 256; i++)
+   if (dut.iram[i] != ref.iram[i])
+   {
+    char buf[64];
+
+    snprintf(buf, sizeof(buf), "    iram[%02x] spec %02x got %02x\n", i,
+             ref.iram[i], dut.iram[i]);
+    out += buf;
+   }
+ }
+ // Undo XDATA writes so both machines keep identical memories.
+ for (i = 0; i < 3; i++)
+  ref.xdata[x[i]] = dut.xdata[x[i]] = xsave[i];
+ return ok;
+}
+
+static void test_opcode(bench& t, unsigned op, unsigned long long random,
+                        result& res)
+{
+ unsigned long long n = exhaustive(op), k;
+ std::string out;
+
+ for (k = 0; k < n + random; k++)
+ {
+  random_state(t, op);
+  if (k < n)
+   set_exhaustive(*t.ref, op, n, k);
+  res.cases++;
+  if (!run_case(t, out) && res.failures++ == 0)
+   res.first = out;
+ }
+}
+
+// Test programs for the model -------------------------------------------
+
+//! Direct addresses and bits a test program may touch freely: RAM and
+//! the CPU registers, but not SP, ports or peripheral SFRs.
+static unsigned safe_direct(rng& r)
+{
+ static const unsigned char sfr[] = { 0xE0, 0xF0, 0x82, 0x83, 0xD0 };
+ unsigned v = r.next() % 160;
+
+ return v < 128 ? v : sfr[v % 5];
+}
+
+static unsigned safe_bit(rng& r)
+{
+ static const unsigned char sfr[] = { 0xE0, 0xF0, 0xD0 };
+ unsigned v = r.next() % 160;
+
+ return v < 128 ? v : sfr[v % 3] | (v & 7);
+}
+
+struct program
+{
+ unsigned char code[0x10000];
+ unsigned size;
+
+ void emit(unsigned v) { code[size++] = v; }
+ void emit(unsigned a, unsigned b) { emit(a); emit(b); }
+ void emit(unsigned a, unsigned b, unsigned c) { emit(a, b); emit(c); }
+};
+
+//! One test of op: random registers, then the instruction. Control
+//! transfers go to the next instruction + 1, skipping a NOP, so taken
+//! and not taken branches leave different PC traces for the lockstep
+//! check.
+static void emit_test(program& p, unsigned op, rng& r)
+{
+ const i8051_opinfo& o = i8051_optable[op];
+ unsigned a = r.byte(), target, dptr, i, opd[3];
+ unsigned char b[3];
+ bool ret = is(o.mnemonic, "ret reti");
+
+ // Operand bytes first; the setup below then fills what they name.
+ b[0] = op;
+ b[1] = r.byte();
+ b[2] = r.byte();
+ for (i = 0; i < o.nopd; i++)
+ {
+  opd[i] = 0;
+  switch (o.opd[i].kind)
+  {
+   case I8051_OPD_DIR:
+    b[o.opd[i].byte] = opd[i] = safe_direct(r);
+    break;
+   case I8051_OPD_BIT: case I8051_OPD_NBIT:
+    b[o.opd[i].byte] = opd[i] = safe_bit(r);
+    break;
+  }
+ }
+
+ p.emit(0x75, I8051_SP, 0x40 + r.next() % 0x30);
+ p.emit(0x75, I8051_PSW, r.byte());
+ p.emit(0x75, I8051_B, r.byte());
+ p.emit(0x75, I8051_P2, r.next() % 0xF0);
+ for (i = 0; i < 8; i++)
+  p.emit(0x78 + i, r.next() & 0x7F);
+ p.emit(0x75, 0x20 + r.next() % 16, r.byte());
+ for (i = 0; i < o.nopd; i++)
+  if (o.opd[i].kind == I8051_OPD_DIR && opd[i] < 0x80)
+   p.emit(0x75, opd[i], r.byte());
+ // Fixed size tail: PUSH return address (ret), DPTR, A.
+ target = (p.size + (ret ? 8 : 0) + 6 + 2 + o.length + 1) & 0xFFFF;
+ if (o.opd[0].kind == I8051_OPD_ADDR11 &&
+     (target & 0xF800) != ((target - 1) & 0xF800))
+ {
+  p.emit(0x00);
+  target++;
+ }
+ if (ret)
+ {
+  p.emit(0x74, target & 0xFF);
+  p.emit(0xC0, I8051_ACC);
+  p.emit(0x74, target >> 8);
+  p.emit(0xC0, I8051_ACC);
+ }
+ dptr = (r.next() % 0xF000) | r.byte();
+ if (op == 0x73)                        // JMP @A+DPTR
+  dptr = (target - a) & 0xFFFF;
+ p.emit(0x75, I8051_DPL, dptr & 0xFF);
+ p.emit(0x75, I8051_DPH, dptr >> 8);
+ p.emit(0x74, a);
+
+ for (i = 0; i < o.nopd; i++)
+  switch (o.opd[i].kind)
+  {
+   case I8051_OPD_REL:
+    b[o.opd[i].byte] = 1;
+    break;
+   case I8051_OPD_ADDR11:
+    b[0] = ((target >> 3) & 0xE0) | (op & 0x1F);
+    b[1] = target & 0xFF;
+    break;
+   case I8051_OPD_ADDR16:
+    b[1] = target >> 8;
+    b[2] = target & 0xFF;
+    break;
+  }
+ for (i = 0; i < o.length; i++)
+  p.emit(b[i]);
+ p.emit(0x00);
+}
+
+static bool write_hex(const char* fn, const program& p)
+{
+ FILE* f = fopen(fn, "w");
+ unsigned a, i, n, sum;
+
+ if (f == NULL)
+ {
+  fprintf(stderr, "i8051_optest: cannot create '%s'\n", fn);
+  return false;
+ }
+ for (a = 0; a < p.size; a += n)
+ {
+  n = p.size - a < 16 ? p.size - a : 16;
+  sum = n + (a >> 8) + (a & 0xFF);
+  fprintf(f, ":%02X%04X00", n, a);
+  for (i = 0; i < n; i++)
+  {
+   fprintf(f, "%02X", p.code[a + i]);
+   sum += p.code[a + i];
+  }
+  fprintf(f, "%02X\n", (0x100 - (sum & 0xFF)) & 0xFF);
+ }
+ fprintf(f, ":00000001FF\n");
+ fclose(f);
+ return true;
+}
+
+//! Write dir/opXX.hex for every defined opcode. Each program ends in
+//! "sjmp $" with interrupts disabled, which stops the model.
+static bool write_images(const char* dir, unsigned tests, unsigned seed)
+{
+ program* p = new program;
+ char fn[4096];
+ unsigned op, k;
+ rng r;
+ bool ok = true;
+
+ r.x = seed * 0x9E3779B97F4A7C15ULL | 1;
+ for (op = 0; op < 256 && ok; op++)
+ {
+  if (i8051_optable[op].mnemonic == NULL)
+   continue;
+  p->size = 0;
+  for (k = 0; k < tests; k++)
+   emit_test(*p, op, r);
+  p->emit(0x75, 0xA8, 0x00);            // IE
+  p->emit(0x80, 0xFE);
+  snprintf(fn, sizeof(fn), "%s/op%02X.hex", dir, op);
+  ok = write_hex(fn, *p);
+ }
+ delete p;
+ return ok;
+}
+
+// ------------------------------------------------------------------------
+
+static void usage()
+{
+ fprintf(stderr,
+         "usage: i8051_optest [-j threads] [-n random cases] [-s seed]\n"
+         "       i8051_optest -i dir [-n tests] [-s seed]\n");
+ exit(2);
+}
+
+int main(int argc, char** argv)
+{
+ unsigned threads = std::thread::hardware_concurrency();
+ unsigned long long random = 20000;
+ unsigned seed = 1, t, op;
+ const char* images = NULL;
+ std::atomic<unsigned> next(0);
+ std::vector<std::thread> pool;
+ result res[256];
+ unsigned long long cases = 0, failures = 0;
+ int c;
+
+ while ((c = getopt(argc, argv, "j:n:s:i:")) != -1)
+  switch (c)
+  {
+   case 'j': threads = atoi(optarg); break;
+   case 'n': random = strtoull(optarg, NULL, 0); break;
+   case 's': seed = atoi(optarg); break;
+   case 'i': images = optarg; break;
+   default: usage();
+  }
+ if (optind != argc)
+  usage();
+ if (images != NULL)
+ {
+  // About 50 bytes per test must fit into the 64K code space.
+  if (random > 1000)
+   random = 1000;
+  return write_images(images, random, seed) ? 0 : 1;
+ }
+ if (threads == 0)
+  threads = 1;
+
+ for (op = 0; op < 256; op++)
+ {
+  res[op].cases = 0;
+  res[op].failures = 0;
+ }
+ auto start = std::chrono::steady_clock::now();
+ for (t = 0; t < threads; t++)
+  pool.push_back(std::thread([&, t]() {
+   bench b(seed * 1000003ULL + t);
+   unsigned op;
+
+   while ((op = next++) < 256)
+    test_opcode(b, op, random, res[op]);
+  }));
+ for (auto& th : pool)
+  th.join();
+ double secs = std::chrono::duration<double>(
+                 std::chrono::steady_clock::now() - start).count();
+
+ for (op = 0; op < 256; op++)
+ {
+  const i8051_opinfo& o = i8051_optable[op];
+
+  cases += res[op].cases;
+  failures += res[op].failures;
+  if (res[op].failures == 0)
+   continue;
+  printf("%02X %-28s %llu of %llu cases fail, first:\n%s", op,
+         o.syntax ? o.syntax : "(reserved)", res[op].failures,
+         res[op].cases, res[op].first.c_str());
+ }
+ printf("%llu cases, %llu failures, %.2f s, %.2f Mcases/s on %u threads\n",
+        cases, failures, secs, cases / secs / 1e6, threads);
+ return failures != 0;
+}
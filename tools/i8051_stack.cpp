@@ -0,0 +1,494 @@
+/**
+ * @file      i8051_stack.cpp
+ * @author    The ArchC Team
+ *            http://www.archc.org/
+ *
+ *            Computer Systems Laboratory (LSC)
+ *            IC-UNICAMP
+ *            http://www.lsc.ic.unicamp.br/
+ *
+ * @version   1.0
+ * @date      Wed, 21 Oct 2026 09:26:44 -0300
+ *
+ * @brief     Static worst-case stack depth and call graph of an image.
+ *
+ * The image is decoded with the opcode table generated from the ISA
+ * description (i8051_optable.H) starting at the reset vector and at
+ * every interrupt vector that holds code not reached from reset. Each
+ * entry and every acall/lcall target is a function; its body is what
+ * jumps and branches reach up to ret/reti. Along every path the tool
+ * tracks the bytes pushed since the function entry (push, pop, calls),
+ * so a function's depth is its own deepest point or a call site's depth
+ * plus 2 plus the callee's depth, whichever is larger.
+ *
+ * The stack starts at SP = 0x07, or at the value of the first
+ * "mov SP, #data" found. Interrupt handlers add their depth plus the 2
+ * bytes of the hardware call on top of the main program; with two
+ * priority levels (IP) the two deepest handlers can nest, with -1 only
+ * one runs at a time.
+ *
+ * The result cannot be trusted, and the exit status is 1, when the
+ * program has recursion, paths that reach the same instruction with
+ * different depths, ret with bytes still pushed, other SP writes, or a
+ * jmp @A+DPTR (its targets can be added with -e as extra functions);
+ * all of these are listed. The exit status is also 1 if the worst case
+ * goes above the limit.
+ *
+ *     g++ -O2 -I.. -o i8051_stack i8051_stack.cpp
+ *     ./i8051_stack [-e addr,...] [-i vector,...] [-l limit] [-1] [-8]
+ *                   [-g] image
+ *
+ *     -e  extra entry points (jump table targets)
+ *     -i  interrupt vectors in use (default: guessed as above)
+ *     -l  highest IRAM address the stack may use (default 0x7F,
+ *         0xFF with -8)
+ *     -g  print the call graph for Graphviz instead of the report
+ *
+ * @attention Copyright (C) 2002-2006 --- The ArchC Team
+ *
+ */
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "i8051_core.H"
+#include "i8051_loader.H"
+#include "i8051_optable.H"
+
+//! What an opcode does to the stack and to control flow.
+enum op_class
+{
+ OC_PLAIN, OC_PUSH, OC_POP, OC_CALL, OC_RET, OC_JUMP, OC_BRANCH,
+ OC_INDIRECT
+};
+
+//! Kinds of issue, reported once per instruction.
+enum
+{
+ I_LEAVE = 1, I_PATH = 2, I_RESERVED = 4, I_SP = 8, I_RET = 16,
+ I_INDIRECT = 32, I_RECURSION = 64
+};
+
+static const unsigned vectors[] = { 0x03, 0x0B, 0x13, 0x1B, 0x23, 0x2B };
+
+struct call_site
+{
+ unsigned pc, target;
+ int depth;                     // bytes pushed at the call
+};
+
+struct function
+{
+ unsigned entry;
+ int frame;                     // deepest point of its own body
+ int depth;                     // with callees; -1 while being computed
+ bool done, isr;
+ std::vector<call_site> calls;
+};
+
+struct analysis
+{
+ const unsigned char* code;
+ unsigned lo, hi;
+ unsigned char cls[256];
+ std::map<unsigned, function> funcs;
+ std::vector<std::string> issues;
+ std::vector<unsigned char> flagged;    // issue kinds per instruction
+ std::vector<unsigned char> covered;    // code bytes reached
+ int sp_init;                   // -1 until a "mov SP, #data"
+ // Per instruction: function that reached it last and with what depth
+ std::vector<unsigned> owner;
+ std::vector<int> seen;
+};
+
+static void issue(analysis& a, unsigned pc, unsigned kind, const char* fmt,
+                  ...) __attribute__((format(printf, 4, 5)));
+
+static void issue(analysis& a, unsigned pc, unsigned kind, const char* fmt,
+                  ...)
+{
+ char buf[160];
+ int n;
+ va_list ap;
+
+ if (a.flagged[pc] & kind)
+  return;
+ a.flagged[pc] |= kind;
+ n = snprintf(buf, sizeof(buf), "%04X: ", pc);
+ va_start(ap, fmt);
+ vsnprintf(buf + n, sizeof(buf) - n, fmt, ap);
+ va_end(ap);
+ a.issues.push_back(buf);
+}
+
+static void classify(analysis& a)
+{
+ for (unsigned op = 0; op < 256; op++)
+ {
+  const i8051_opinfo& o = i8051_optable[op];
+  const char* m = o.mnemonic ? o.mnemonic : "";
+  unsigned char& c = a.cls[op];
+
+  c = OC_PLAIN;
+  if (!strcmp(m, "push"))
+   c = OC_PUSH;
+  else if (!strcmp(m, "pop"))
+   c = OC_POP;
+  else if (!strcmp(m, "acall") || !strcmp(m, "lcall"))
+   c = OC_CALL;
+  else if (!strcmp(m, "ret") || !strcmp(m, "reti"))
+   c = OC_RET;
+  else if (!strcmp(m, "jmp"))
+   c = OC_INDIRECT;
+  else if (!strcmp(m, "sjmp") || !strcmp(m, "ajmp") || !strcmp(m, "ljmp"))
+   c = OC_JUMP;
+  else
+   for (unsigned k = 0; k < o.nopd; k++)
+    if (o.opd[k].kind == I8051_OPD_REL)
+     c = OC_BRANCH;
+ }
+}
+
+//! Jump or branch target of the instruction at pc.
+static unsigned target(const analysis& a, unsigned pc)
+{
+ unsigned op = a.code[pc], next = (pc + i8051_length[op]) & 0xFFFF;
+ const i8051_opinfo& o = i8051_optable[op];
+
+ for (unsigned k = 0; k < o.nopd; k++)
+ {
+  unsigned b = a.code[(pc + o.opd[k].byte) & 0xFFFF];
+
+  switch (o.opd[k].kind)
+  {
+   case I8051_OPD_REL:
+    return (next + (signed char) b) & 0xFFFF;
+   case I8051_OPD_ADDR11:
+    return (next & 0xF800) | ((op & 0xE0) << 3) | b;
+   case I8051_OPD_ADDR16:
+    return (b << 8) | a.code[(pc + o.opd[k].byte + 1) & 0xFFFF];
+  }
+ }
+ return next;
+}
+
+//! Whether the instruction at pc writes SP; "mov SP, #data" sets imm.
+static bool writes_sp(const analysis& a, unsigned pc, int& imm)
+{
+ unsigned op = a.code[pc];
+ const i8051_opinfo& o = i8051_optable[op];
+ unsigned n = o.mnemonic && !strcmp(o.mnemonic, "xch") ? 1 : 0;
+
+ imm = -1;
+ if (o.nopd <= n || o.opd[n].kind != I8051_OPD_DIR ||
+     a.code[(pc + o.opd[n].byte) & 0xFFFF] != I8051_SP ||
+     a.cls[op] == OC_PUSH || !strcmp(o.mnemonic, "cjne"))
+  return false;
+ if (op == 0x75)
+  imm = a.code[(pc + 2) & 0xFFFF];
+ return true;
+}
+
+//! Walk the body of f, recording its frame and call sites.
+static void walk(analysis& a, function& f)
+{
+ std::vector<std::pair<unsigned, int> > work;
+ unsigned id = f.entry + 1;
+
+ f.frame = 0;
+ work.push_back(std::make_pair(f.entry, 0));
+ while (!work.empty())
+ {
+  unsigned pc = work.back().first;
+  int d = work.back().second;
+
+  work.pop_back();
+  for (;;)
+  {
+   unsigned op = a.code[pc], next = (pc + i8051_length[op]) & 0xFFFF;
+   int imm;
+
+   if (pc - a.lo >= a.hi - a.lo)
+   {
+    issue(a, pc, I_LEAVE, "execution leaves the image");
+    break;
+   }
+   if (a.owner[pc] == id)
+   {
+    if (a.seen[pc] != d)
+     issue(a, pc, I_PATH, "reached with %d and %d bytes pushed",
+           a.seen[pc], d);
+    break;
+   }
+   a.owner[pc] = id;
+   a.seen[pc] = d;
+   for (unsigned k = 0; k < i8051_length[op]; k++)
+    a.covered[(pc + k) & 0xFFFF] = 1;
+   if (d > f.frame)
+    f.frame = d;
+   if (i8051_optable[op].name == NULL)
+    issue(a, pc, I_RESERVED, "reserved opcode %02X", op);
+   if (writes_sp(a, pc, imm))
+   {
+    if (imm >= 0 && a.sp_init < 0 && !f.isr)
+    {
+     a.sp_init = imm;
+     d = 0;
+    }
+    else
+     issue(a, pc, I_SP, "SP written by %s", i8051_optable[op].syntax);
+   }
+   switch (a.cls[op])
+   {
+    case OC_PUSH: d++; break;
+    case OC_POP: d--; break;
+    case OC_CALL:
+     {
+      call_site s = { pc, target(a, pc), d };
+
+      f.calls.push_back(s);
+      if (d + 2 > f.frame)
+       f.frame = d + 2;
+     }
+     break;
+    case OC_RET:
+     if (d != 0)
+      issue(a, pc, I_RET, "%s with %d bytes pushed",
+            i8051_optable[op].mnemonic, d);
+     break;
+    case OC_INDIRECT:
+     issue(a, pc, I_INDIRECT,
+           "jmp @A+DPTR: targets unknown (add them with -e)");
+     break;
+    case OC_BRANCH:
+     work.push_back(std::make_pair(target(a, pc), d));
+     break;
+    case OC_JUMP:
+     next = target(a, pc);
+     break;
+   }
+   // "sjmp $" ends the program.
+   if (a.cls[op] == OC_RET || a.cls[op] == OC_INDIRECT || next == pc)
+    break;
+   pc = next;
+  }
+ }
+}
+
+//! Depth of f including its callees, -1 if unbounded.
+static int depth(analysis& a, function& f)
+{
+ if (f.done)
+  return f.depth;
+ if (f.depth == -1)
+  return -1;                    // on the current call chain: recursion
+ f.depth = -1;
+ int d = f.frame;
+
+ for (size_t k = 0; k < f.calls.size(); k++)
+ {
+  const call_site& s = f.calls[k];
+  function& g = a.funcs[s.target];
+  int c = depth(a, g);
+
+  if (c < 0)
+  {
+   if (!g.done)
+    issue(a, s.pc, I_RECURSION, "recursive call to %04X", s.target);
+   d = -1;
+   break;
+  }
+  if (s.depth + 2 + c > d)
+   d = s.depth + 2 + c;
+ }
+ f.depth = d;
+ f.done = true;
+ return d;
+}
+
+static bool parse_list(const char* s, std::vector<unsigned>& out)
+{
+ char* end;
+
+ for (;;)
+ {
+  out.push_back(strtoul(s, &end, 16) & 0xFFFF);
+  if (end == s)
+   return false;
+  if (*end == 0)
+   return true;
+  if (*end != ',')
+   return false;
+  s = end + 1;
+ }
+}
+
+static void usage()
+{
+ fprintf(stderr, "usage: i8051_stack [-e addr,...] [-i vector,...] "
+                 "[-l limit] [-1] [-8] [-g] image\n");
+ exit(2);
+}
+
+int main(int argc, char** argv)
+{
+ static unsigned char code[0x10000];
+ std::vector<unsigned> entries, isrs;
+ analysis a;
+ i8051_image img;
+ unsigned limit = 0x7F;
+ bool limit_set = false, one_level = false, graph = false, guess = true;
+ int c;
+
+ while ((c = getopt(argc, argv, "e:i:l:18g")) != -1)
+  switch (c)
+  {
+   case 'e':
+    if (!parse_list(optarg, entries))
+     usage();
+    break;
+   case 'i':
+    if (!parse_list(optarg, isrs))
+     usage();
+    guess = false;
+    break;
+   case 'l': limit = strtoul(optarg, NULL, 16); limit_set = true; break;
+   case '1': one_level = true; break;
+   case '8':
+    if (!limit_set)
+     limit = 0xFF;
+    break;
+   case 'g': graph = true; break;
+   default: usage();
+  }
+ if (optind + 1 != argc)
+  usage();
+
+ memset(code, 0xFF, sizeof(code));
+ img.code = code;
+ img.xdata = NULL;
+ if (!i8051_load(argv[optind], &img))
+  return 2;
+ if (img.code_lo >= img.code_hi)
+ {
+  fprintf(stderr, "i8051_stack: %s holds no code\n", argv[optind]);
+  return 2;
+ }
+ a.code = code;
+ a.lo = img.code_lo;
+ a.hi = img.code_hi;
+ a.sp_init = -1;
+ a.owner.assign(0x10000, 0);
+ a.seen.assign(0x10000, 0);
+ a.covered.assign(0x10000, 0);
+ a.flagged.assign(0x10000, 0);
+ classify(a);
+
+ // Functions, breadth first from the entries: reset, then the vectors
+ // that the code reached so far does not run through.
+ std::vector<unsigned> todo;
+ size_t k;
+
+ todo.push_back(img.entry);
+ for (k = 0; k < entries.size(); k++)
+  todo.push_back(entries[k]);
+ for (int pass = 0; pass < 2; pass++)
+ {
+  for (k = 0; k < todo.size(); k++)
+  {
+   unsigned e = todo[k];
+
+   if (a.funcs.count(e))
+    continue;
+   function& f = a.funcs[e];
+
+   f.entry = e;
+   f.depth = 0;
+   f.done = false;
+   f.isr = pass == 1 && std::find(isrs.begin(), isrs.end(), e) != isrs.end();
+   walk(a, f);
+   for (size_t j = 0; j < f.calls.size(); j++)
+    todo.push_back(f.calls[j].target);
+  }
+  if (pass == 0)
+  {
+   if (guess)
+    for (unsigned v: vectors)
+     if (v - a.lo < a.hi - a.lo && !a.covered[v] && code[v] != 0xFF)
+      isrs.push_back(v);
+   todo.assign(isrs.begin(), isrs.end());
+  }
+ }
+
+ if (graph)
+ {
+  printf("digraph calls {\n");
+  for (auto& p: a.funcs)
+  {
+   printf(" f%04X [label=\"%04X\\n%d\"%s];\n", p.first, p.first,
+          p.second.frame, p.second.isr ? " shape=box" : "");
+   for (const call_site& s: p.second.calls)
+    printf(" f%04X -> f%04X [label=\"%d\"];\n", p.first, s.target, s.depth);
+  }
+  printf("}\n");
+  return 0;
+ }
+
+ int main_depth = depth(a, a.funcs[img.entry]), isr1 = 0, isr2 = 0;
+ bool bounded = main_depth >= 0;
+
+ printf("function  frame  depth  calls\n");
+ for (auto& p: a.funcs)
+ {
+  function& f = p.second;
+  int d = depth(a, f);
+
+  printf("%04X%s  %5d  ", f.entry, f.isr ? "*" : " ", f.frame);
+  if (d < 0)
+   printf("    ?");
+  else
+   printf("%5d", d);
+  for (const call_site& s: f.calls)
+   printf(" %04X", s.target);
+  printf("\n");
+  if (f.isr)
+  {
+   if (d < 0)
+    bounded = false;
+   else if (d + 2 > isr1)
+   {
+    isr2 = isr1;
+    isr1 = d + 2;
+   }
+   else if (d + 2 > isr2)
+    isr2 = d + 2;
+  }
+ }
+ if (one_level)
+  isr2 = 0;
+
+ unsigned base = a.sp_init >= 0 ? a.sp_init : 0x07;
+ unsigned worst = base + (main_depth > 0 ? main_depth : 0) + isr1 + isr2;
+
+ printf("(* interrupt handler)\n\n");
+ std::sort(a.issues.begin(), a.issues.end());
+ for (k = 0; k < a.issues.size(); k++)
+  printf("warning: %s\n", a.issues[k].c_str());
+ if (!bounded)
+ {
+  printf("stack: unbounded\n");
+  return 1;
+ }
+ printf("stack: SP 0x%02X + %d main + %d interrupts = 0x%02X, limit 0x%02X\n",
+        base, main_depth, isr1 + isr2, worst, limit);
+ if (base < 0x20 && base + main_depth + isr1 + isr2 > 0x1F)
+  printf("note: the stack grows over the bit-addressable area (20-2F)\n");
+ return worst > limit || !a.issues.empty();
+}
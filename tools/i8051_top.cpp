@@ -0,0 +1,117 @@
+/**
+ * @file      i8051_top.cpp
+ * @author    The ArchC Team
+ *            http://www.archc.org/
+ *
+ *            Computer Systems Laboratory (LSC)
+ *            IC-UNICAMP
+ *            http://www.lsc.ic.unicamp.br/
+ *
+ * @version   1.0
+ * @date      Mon, 26 Oct 2026 11:20:37 -0300
+ *
+ * @brief     Follows a running simulation through its live segment.
+ *
+ * Reads the shared memory a model run with I8051_LIVE publishes (see
+ * i8051_live.H) without stopping it, and prints one line per interval:
+ * instructions, machine cycles, PC and the MIPS of the last period.
+ * With -m, and a model run with ",mem", it also dumps the direct
+ * address space. It exits when the run ends, after its final state.
+ *
+ *     g++ -O2 -I.. -o i8051_top i8051_top.cpp -lrt
+ *     ./i8051_top [-i <ms>] [-m] [-1] /i8051
+ *
+ *     -i <ms>    interval (default 1000)
+ *     -m         dump IRAM and SFRs at every line
+ *     -1         print the current state once and exit
+ *
+ * @attention Copyright (C) 2002-2006 --- The ArchC Team
+ *
+ */
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "i8051_live.H"
+
+static void dump(const unsigned char* m)
+{
+ unsigned i, j;
+
+ for (i = 0; i < 256; i += 16)
+ {
+  printf("  %02x:", i);
+  for (j = 0; j < 16; j++)
+   printf(" %02x", m[i + j]);
+  printf("\n");
+ }
+}
+
+int main(int argc, char** argv)
+{
+ const char* usage = "usage: %s [-i ms] [-m] [-1] name\n";
+ // Counters and IRAM, not the rest of the memories
+ size_t len = offsetof(i8051_live_data, idata);
+ unsigned ms = 1000;
+ bool mem = false, once = false;
+ const i8051_live_data* d;
+ i8051_live_data s;
+ uint32_t last = 0;
+ int fd, o;
+
+ while ((o = getopt(argc, argv, "i:m1")) != -1)
+  switch (o)
+  {
+   case 'i': ms = atoi(optarg); break;
+   case 'm': mem = true; break;
+   case '1': once = true; break;
+   default:
+    fprintf(stderr, usage, argv[0]);
+    return 2;
+  }
+ if (optind + 1 != argc)
+ {
+  fprintf(stderr, usage, argv[0]);
+  return 2;
+ }
+ if ((fd = shm_open(argv[optind], O_RDONLY, 0)) < 0)
+ {
+  fprintf(stderr, "i8051: cannot open shared memory '%s'\n", argv[optind]);
+  return 2;
+ }
+ d = (const i8051_live_data*) mmap(NULL, sizeof(i8051_live_data),
+                                   PROT_READ, MAP_SHARED, fd, 0);
+ close(fd);
+ if (d == MAP_FAILED || !i8051_live_read(d, &s, len) ||
+     s.version != I8051_LIVE_VERSION)
+ {
+  fprintf(stderr, "i8051: '%s' is not a live segment\n", argv[optind]);
+  return 2;
+ }
+ printf("%14s %14s %6s %8s %10s\n", "insts", "cycles", "pc", "MIPS",
+        "seconds");
+ for (;;)
+ {
+  i8051_live_read(d, &s, len);
+  if (s.updates != last || once)
+  {
+   last = s.updates;
+   printf("%14llu %14llu   %04x %8.2f %10.2f%s\n",
+          (unsigned long long) s.insts, (unsigned long long) s.cycles,
+          (unsigned) s.pc, s.mips, s.host_seconds,
+          s.flags & I8051_LIVE_RUNNING ? "" : "  (ended)");
+   if (mem && (s.flags & I8051_LIVE_MEM))
+    dump(s.iram);
+   fflush(stdout);
+  }
+  if (once || !(s.flags & I8051_LIVE_RUNNING))
+   break;
+  usleep(ms * 1000);
+ }
+ return 0;
+}